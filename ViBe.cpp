@@ -27,6 +27,816 @@
 
 #include <vul/vul_arg.h>
 
+#include "ViBe_Stream.h"
+#include "ViBe_FrameIO.h"
+#include "ViBe_AllocCounter.h"
+#include "ViBe_Checkpoint.h"
+#include "ViBe_Follow.h"
+#include "ViBe_Manifest.h"
+#include "ViBe_Prefetch.h"
+#include "ViBe_ModelBank.h"
+
+#ifndef _STDIO_
+#define _STDIO_
+#include <stdio.h>
+#endif
+
+#ifndef _CTYPE_
+#define _CTYPE_
+#include <ctype.h>
+#endif
+
+#ifndef _VCL_ALGORITHM_
+#define _VCL_ALGORITHM_
+#include <vcl_algorithm.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * Model settings given on the command line, applied alike to every model a frame loop creates
+ */
+struct ModelOptions
+{
+    unsigned updateEvery;
+    int distanceMode;               // DISTANCE_RGB or DISTANCE_CHROMA
+    bool sorted;
+    bool envelope;
+    bool packed;
+    unsigned approximate;
+    bool checkerboard;
+    int illuminationMode;           // ILLUMINATION_OFF, ILLUMINATION_FAST_UPDATE or ILLUMINATION_RESEED
+    double illuminationThreshold;
+    unsigned jitter;
+};
+
+static void ApplyModelOptions(ViBe_Model& Model, const ModelOptions& options)
+{
+    Model.SetUpdateInterval(options.updateEvery);
+    Model.SetDistanceMode(options.distanceMode);
+    Model.SetSortedMatching(options.sorted);
+    Model.SetEnvelopeRejection(options.envelope);
+    Model.SetPackedMatching(options.packed);
+    Model.SetApproximateMatching(options.approximate);
+    Model.SetCheckerboard(options.checkerboard);
+    Model.SetJitterCompensation(options.jitter);
+    if (options.illuminationMode != ILLUMINATION_OFF)
+    {
+        Model.SetIlluminationAdaptation(options.illuminationMode, options.illuminationThreshold, ILLUMINATION_FRAMES);
+    }
+}
+
+/// the frame loops main can pick, as bits so that a flag can list the loops that honour it
+#define LOOP_STREAM 1
+#define LOOP_SWEEP 2
+#define LOOP_CHUNKS 4
+#define LOOP_FOLLOW 8
+#define LOOP_WAVEFRONT 16
+#define LOOP_FUSED 32
+#define LOOP_STEADY 64
+#define LOOP_NORMAL 128
+
+/*
+ * A command line flag that only some of the frame loops honour
+ */
+struct LoopFlag
+{
+    const char* name;
+    bool given;
+    int loops;                      // LOOP_ bits of the loops that honour it
+};
+
+/*
+ * Report the flags given that the chosen loop would ignore, so a run never silently does less than was asked of it.
+ * Returns false if there were any
+ */
+static bool CheckLoopFlags(int loop, const char* loopName, const LoopFlag* flags, int numFlags)
+{
+    bool honoured = true;
+    for (int f = 0; f < numFlags; f++)
+    {
+        if (flags[f].given && !(flags[f].loops & loop))
+        {
+            vcl_cout << flags[f].name << " can't be used with " << loopName << vcl_endl;
+            honoured = false;
+        }
+    }
+    return honoured;
+}
+
+/*
+ * Segment a stream of frames read from stdin or a named pipe, writing the masks in the same framing as they are produced.
+ * The first NUM_TRAINING_IMAGES frames are held back to train the model, after that each frame is segmented as soon as
+ * it arrives. Diagnostics go to vcl_cerr, as stdout may be carrying the masks.
+ */
+static int SegmentStream(vcl_string inPath, vcl_string outPath, int width, int height, const ModelOptions& options)
+{
+    ViBe_StreamReader reader;
+    if (!reader.Open(inPath, width, height))
+    {
+        vcl_cerr << "Unable to read stream " << inPath << ", give -width and -height for raw RGB streams" << vcl_endl;
+        return 1;
+    }
+
+    vcl_vector< vil_image_view<unsigned char> > trainingImages;
+    while (trainingImages.size() < NUM_TRAINING_IMAGES)
+    {
+        vil_image_view<unsigned char> frame;
+        if (!reader.ReadFrame(frame))
+        {
+            break;
+        }
+        trainingImages.push_back(frame);
+    }
+    if (trainingImages.size() == 0)
+    {
+        vcl_cerr << "No input frames, exiting." << vcl_endl;
+        return 0;
+    }
+
+    ViBe_StreamWriter writer;
+    if (!writer.Open(outPath, reader))
+    {
+        vcl_cerr << "Unable to write stream " << outPath << vcl_endl;
+        return 1;
+    }
+
+    ViBe_Model Model;
+    Model.Init(NUM_SAMPLES, RADIUS, MINSAMPLES, SUBSAMPLING, reader.getWidth(), reader.getHeight());
+    ApplyModelOptions(Model, options);
+    Model.InitBackground(trainingImages);
+
+    vil_image_view<unsigned char> resultImage(reader.getWidth(), reader.getHeight(), 1);
+
+    /// the training frames are segmented too, so every input frame gets a mask
+    for (unsigned i = 0; i < trainingImages.size(); i++)
+    {
+        Model.Segment(trainingImages[i], resultImage);
+        if (!writer.WriteFrame(resultImage))
+        {
+            return 1;
+        }
+    }
+
+    vil_image_view<unsigned char> srcImage;
+    while (reader.ReadFrame(srcImage))
+    {
+        Model.Segment(srcImage, resultImage);
+        if (!writer.WriteFrame(resultImage))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Decode frame i of filenames, taking its file from prefetcher if there is one (which must be at frame i), files that
+ * aren't JPEGs are read again and loaded normally
+ */
+static bool DecodeFrame(ViBe_FrameDecoder& decoder, ViBe_FramePrefetcher* prefetcher, vcl_string& filename)
+{
+    if (prefetcher != NULL)
+    {
+        const unsigned char* data;
+        unsigned long size;
+        prefetcher->Next(data, size);
+        if ((size > 0) && ViBe_FrameDecoder::isJpeg(data, size))
+        {
+            return decoder.DecodeMemory(data, size);
+        }
+    }
+    return decoder.DecodeFile(filename.c_str());
+}
+
+/*
+ * Whether a decoded frame is the size of the model, frames that aren't (a differently sized file in the sequence, or a
+ * file the reduced modes couldn't reduce) are reported and should be skipped
+ */
+static bool FitsModel(ViBe_Model& Model, vil_image_view<unsigned char>& frame, const vcl_string& filename)
+{
+    if (((int)frame.ni() != Model.getWidth()) || ((int)frame.nj() != Model.getHeight()))
+    {
+        vcl_cerr << filename << " is not the size of the model, skipped" << vcl_endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Whether a file name (or glob, such as *jpeg) ends in a JPEG extension, jpg, jpeg or jpe in any case
+ */
+static bool HasJpegExtension(const vcl_string& name)
+{
+    vcl_string lower = name;
+    for (unsigned c = 0; c < lower.size(); c++)
+    {
+        lower[c] = (char)tolower((unsigned char)lower[c]);
+    }
+    const char* extensions[] = { "jpg", "jpeg", "jpe" };
+    for (unsigned e = 0; e < sizeof(extensions) / sizeof(extensions[0]); e++)
+    {
+        vcl_string extension(extensions[e]);
+        if ((lower.size() >= extension.size()) &&
+            (lower.compare(lower.size() - extension.size(), extension.size(), extension) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Let the bank look at frame i before it is segmented, reporting when it switches scene
+ */
+static void UpdateBank(ViBe_ModelBank* bank, vil_image_view<unsigned char>& frame, long i)
+{
+    if (bank == NULL)
+    {
+        return;
+    }
+    int result = bank->Update(frame);
+    if (result == BANK_STORED)
+    {
+        vcl_cerr << "Frame " << i << ": switched to stored scene " << bank->getActiveScene() << vcl_endl;
+    }
+    else if (result == BANK_NEW)
+    {
+        vcl_cerr << "Frame " << i << ": new scene " << bank->getActiveScene() << ", learning it" << vcl_endl;
+    }
+}
+
+/*
+ * Steady state frame loop, segments every file in filenames without making heap allocations once it has warmed up.
+ * Frames are decoded into recycled buffers, masks are written into a single reused view and saved as binary PGM,
+ * and output paths are formatted into a fixed buffer.
+ * warmupFrames - if non zero, the allocation counter is reset after this many frames and any later allocation is an error
+ * checkpoints -  if not NULL, a checkpoint of the model is written every checkpointEvery frames
+ * prefetcher -   if not NULL, reads the files ahead of the loop (started on filenames)
+ * bank -         if not NULL, swaps the model's scene when the camera switches scene
+ */
+static int SegmentSteady(ViBe_Model& Model, ViBe_FrameDecoder& decoder, vcl_vector<vcl_string>& filenames,
+                         unsigned warmupFrames, ViBe_CheckpointWriter* checkpoints, unsigned checkpointEvery,
+                         ViBe_FramePrefetcher* prefetcher, ViBe_ModelBank* bank)
+{
+    ViBe_MaskWriter writer;
+    vil_image_view<unsigned char> resultImage;
+    char outputFilename[64];
+
+    for (unsigned i = 0; i < filenames.size(); i++)
+    {
+        if ((warmupFrames > 0) && (i == warmupFrames))
+        {
+            ViBe_AllocCounter::Reset();
+        }
+
+        if (!DecodeFrame(decoder, prefetcher, filenames[i]))
+        {
+            vcl_cerr << "Unable to decode " << filenames[i] << vcl_endl;
+            continue;
+        }
+        vil_image_view<unsigned char>& srcImage = decoder.getImage();
+        if (!FitsModel(Model, srcImage, filenames[i]))
+        {
+            continue;
+        }
+        resultImage.set_size(srcImage.ni(), srcImage.nj(), 1);
+
+        UpdateBank(bank, srcImage, i);
+        Model.Segment(srcImage, resultImage);
+
+        sprintf(outputFilename, "output/BackgroundSegmentation_%u.pgm", i);
+        writer.Save(outputFilename, resultImage);
+
+        if ((checkpoints != NULL) && ((i + 1) % checkpointEvery == 0))
+        {
+            checkpoints->Write(Model, i);
+        }
+
+        if ((warmupFrames > 0) && (i >= warmupFrames) && (ViBe_AllocCounter::getCount() > 0))
+        {
+            vcl_cerr << ViBe_AllocCounter::getCount() << " heap allocations made by steady state frame " << i << vcl_endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Follow mode, segment the frames that keep arriving in a watched directory, in order of frame number, until the
+ * directory goes away. Like SegmentSteady the loop makes no heap allocations once warmed up (other than for the file
+ * names), masks are saved as binary PGM under their frame number
+ */
+static int SegmentFollow(ViBe_Model& Model, ViBe_FrameDecoder& decoder, ViBe_DirectoryWatcher& watcher,
+                         ViBe_CheckpointWriter* checkpoints, unsigned checkpointEvery, ViBe_ModelBank* bank)
+{
+    ViBe_MaskWriter writer;
+    vil_image_view<unsigned char> resultImage;
+    char outputFilename[64];
+    vcl_string filename;
+    long frameNumber;
+    int dropped = 0;
+    int late = 0;
+
+    for (unsigned i = 0; watcher.Next(filename, frameNumber); i++)
+    {
+        if ((watcher.getDropped() != dropped) || (watcher.getLate() != late))
+        {
+            dropped = watcher.getDropped();
+            late = watcher.getLate();
+            vcl_cerr << "Falling behind, " << dropped << " frames dropped from the backlog and " << late
+                     << " arrived too late" << vcl_endl;
+        }
+
+        if (!decoder.DecodeFile(filename.c_str()))
+        {
+            vcl_cerr << "Unable to decode " << filename << vcl_endl;
+            continue;
+        }
+        vil_image_view<unsigned char>& srcImage = decoder.getImage();
+        if (!FitsModel(Model, srcImage, filename))
+        {
+            continue;
+        }
+        resultImage.set_size(srcImage.ni(), srcImage.nj(), 1);
+
+        UpdateBank(bank, srcImage, frameNumber);
+        Model.Segment(srcImage, resultImage);
+
+        sprintf(outputFilename, "output/BackgroundSegmentation_%ld.pgm", frameNumber);
+        writer.Save(outputFilename, resultImage);
+
+        if ((checkpoints != NULL) && ((i + 1) % checkpointEvery == 0))
+        {
+            checkpoints->Write(Model, i);
+        }
+    }
+    vcl_cerr << "Stopped following, the directory can no longer be watched" << vcl_endl;
+    return 1;
+}
+
+static bool EarlierFrame(const vcl_string& a, const vcl_string& b)
+{
+    return ViBe_DirectoryWatcher::FrameNumber(a) < ViBe_DirectoryWatcher::FrameNumber(b);
+}
+
+/*
+ * Offline re-analysis of a long recording, the (sorted) frames are split into numChunks consecutive chunks that are
+ * segmented in parallel, each by its own model. A chunk's model is trained on, and then run over, the overlap frames
+ * before the chunk's first frame without saving their masks, so it has converged by the time the chunk starts. Masks
+ * are saved under their frame index, as in the serial loop, so the output is in order whatever order chunks finish in.
+ * Settings -  model whose settings each chunk's model copies, it is not trained or used itself
+ */
+static int SegmentChunks(ViBe_Model& Settings, vcl_vector<vcl_string>& filenames, int numChunks, int overlap)
+{
+    vcl_sort(filenames.begin(), filenames.end());
+    int numFrames = filenames.size();
+    if (numChunks > numFrames)
+    {
+        numChunks = numFrames;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < numChunks; c++)
+    {
+        int first = (numFrames * c) / numChunks;
+        int last = (numFrames * (c + 1)) / numChunks;
+        int warmup = (first > overlap) ? first - overlap : 0;
+
+        ViBe_Model Model;
+        Model.Init(NUM_SAMPLES, RADIUS, MINSAMPLES, SUBSAMPLING, Settings.getWidth(), Settings.getHeight());
+        Model.CopySettings(Settings);
+        vcl_vector<vcl_string> trainingFiles(filenames.begin() + warmup, filenames.begin() + last);
+        Model.InitBackground(NUM_TRAINING_IMAGES, trainingFiles);
+
+        for (int i = warmup; i < last; i++)
+        {
+            vil_image_view<unsigned char> srcImage = vil_load(filenames[i].c_str());
+            if (!FitsModel(Model, srcImage, filenames[i]))
+            {
+                continue;
+            }
+            vil_image_view<unsigned char> resultImage( srcImage.ni(), srcImage.nj(), 1);
+
+            Model.Segment(srcImage, resultImage);
+
+            if (i >= first)
+            {
+                vcl_stringstream outputFilename;
+                outputFilename << "output/" << "BackgroundSegmentation_" << i << ".png";
+                vil_save(resultImage, outputFilename.str().c_str());
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Segment the frames in batches of batchSize with ViBe_Model::SegmentWavefront, so that several frames are in flight on
+ * different bands at once. Each batch is decoded in parallel before it is segmented
+ */
+static int SegmentWavefront(ViBe_Model& Model, vcl_vector<vcl_string>& filenames, int numBands, int batchSize)
+{
+    if (batchSize < 1)
+    {
+        batchSize = 1;
+    }
+    vcl_vector< vil_image_view<unsigned char> > srcImages;
+    vcl_vector< vil_image_view<unsigned char> > resultImages;
+    vcl_vector<int> frames;
+    for (int first = 0; first < (int)filenames.size(); first += batchSize)
+    {
+        int count = ((int)filenames.size() - first < batchSize) ? (int)filenames.size() - first : batchSize;
+        srcImages.resize(count);
+        resultImages.resize(count);
+        #pragma omp parallel for schedule(dynamic)
+        for (int t = 0; t < count; t++)
+        {
+            srcImages[t] = vil_load(filenames[first + t].c_str());
+            resultImages[t].set_size(srcImages[t].ni(), srcImages[t].nj(), 1);
+        }
+
+        /// drop the frames that aren't the size of the model, keeping the index of the others for their output name
+        frames.clear();
+        for (int t = 0; t < count; t++)
+        {
+            if (FitsModel(Model, srcImages[t], filenames[first + t]))
+            {
+                srcImages[frames.size()] = srcImages[t];
+                resultImages[frames.size()] = resultImages[t];
+                frames.push_back(first + t);
+            }
+        }
+        if (frames.empty())
+        {
+            continue;
+        }
+        srcImages.resize(frames.size());
+        resultImages.resize(frames.size());
+
+        Model.SegmentWavefront(srcImages, resultImages, numBands);
+
+        for (unsigned t = 0; t < frames.size(); t++)
+        {
+            vcl_stringstream outputFilename;
+            outputFilename << "output/" << "BackgroundSegmentation_" << frames[t] << ".png";
+            vil_save(resultImages[t], outputFilename.str().c_str());
+        }
+    }
+    return 0;
+}
+
+/*
+ * Collects the mask rows of a frame segmented by ViBe_FrameDecoder::SegmentFile into a whole mask
+ */
+class MaskAssembler : public ViBe_MaskRowConsumer
+{
+public:
+    vil_image_view<unsigned char> mask;
+
+    void MaskRows(vil_image_view<unsigned char>& maskRows, int firstRow)
+    {
+        for (unsigned j = 0; j < maskRows.nj(); j++)
+        {
+            for (unsigned i = 0; i < maskRows.ni(); i++)
+            {
+                mask(i, firstRow + j) = maskRows(i, j);
+            }
+        }
+    }
+};
+
+/*
+ * Decode and segment each frame together, a group of rows at a time, rather than decoding it in full first
+ * prefetcher - if not NULL, reads the files ahead of the loop (started on filenames)
+ */
+static int SegmentFused(ViBe_Model& Model, ViBe_FrameDecoder& decoder, vcl_vector<vcl_string>& filenames,
+                        ViBe_FramePrefetcher* prefetcher)
+{
+    ViBe_MaskWriter writer;
+    MaskAssembler assembler;
+    assembler.mask.set_size(Model.getWidth(), Model.getHeight(), 1);
+    char outputFilename[64];
+
+    for (unsigned i = 0; i < filenames.size(); i++)
+    {
+        const unsigned char* data = NULL;
+        unsigned long size = 0;
+        if (prefetcher != NULL)
+        {
+            prefetcher->Next(data, size);
+        }
+        bool segmented = ((size > 0) && ViBe_FrameDecoder::isJpeg(data, size)) ?
+                         decoder.SegmentMemory(data, size, Model, assembler) :
+                         decoder.SegmentFile(filenames[i].c_str(), Model, assembler);
+        if (!segmented)
+        {
+            vcl_cerr << "Unable to decode " << filenames[i] << " at the size of the model, skipped" << vcl_endl;
+            continue;
+        }
+        sprintf(outputFilename, "output/BackgroundSegmentation_%u.pgm", i);
+        writer.Save(outputFilename, assembler.mask);
+    }
+    return 0;
+}
+
+/*
+ * Train the model on the first NUM_TRAINING_IMAGES frames as decoded by decoder, for the reduced decoding modes
+ */
+static void TrainFromDecoder(ViBe_Model& Model, ViBe_FrameDecoder& decoder, vcl_vector<vcl_string>& filenames)
+{
+    vcl_vector< vil_image_view<unsigned char> > trainingImages;
+    for (unsigned i = 0; (i < filenames.size()) && (trainingImages.size() < NUM_TRAINING_IMAGES); i++)
+    {
+        if (decoder.DecodeFile(filenames[i].c_str()) && FitsModel(Model, decoder.getImage(), filenames[i]))
+        {
+            /// the decoder's image is overwritten by the next frame
+            trainingImages.push_back(vil_image_view<unsigned char>());
+            trainingImages.back().deep_copy(decoder.getImage());
+        }
+    }
+    Model.InitBackground(trainingImages);
+}
+
+/*
+ * Foreground pixel counts and scores of a mask against a ground truth
+ */
+struct Accuracy
+{
+    long truePositives;
+    long falsePositives;
+    long falseNegatives;
+    long trueNegatives;
+    double precision;
+    double recall;
+    double f1;
+};
+
+/*
+ * Compare a mask to a ground truth image of the same size, where non zero pixels (in the first plane) are foreground,
+ * returns false if the sizes differ
+ */
+static bool MeasureAccuracy(vil_image_view<unsigned char>& groundTruth, vil_image_view<unsigned char>& mask,
+                            Accuracy& accuracy)
+{
+    if ((groundTruth.ni() != mask.ni()) || (groundTruth.nj() != mask.nj()))
+    {
+        return false;
+    }
+    long truePositives = 0; long falsePositives = 0; long falseNegatives = 0; long trueNegatives = 0;
+    for (unsigned j=0; j<mask.nj(); j++)
+    {
+        for (unsigned i=0; i<mask.ni(); i++)
+        {
+            bool expected = groundTruth(i,j,0) != 0;
+            bool found = mask(i,j,0) == FOREGROUND;
+            if (found)
+            {
+                if (expected) truePositives++; else falsePositives++;
+            }
+            else
+            {
+                if (expected) falseNegatives++; else trueNegatives++;
+            }
+        }
+    }
+    accuracy.truePositives = truePositives;
+    accuracy.falsePositives = falsePositives;
+    accuracy.falseNegatives = falseNegatives;
+    accuracy.trueNegatives = trueNegatives;
+    accuracy.precision = (truePositives + falsePositives > 0) ? (double)truePositives / (truePositives + falsePositives) : 0;
+    accuracy.recall = (truePositives + falseNegatives > 0) ? (double)truePositives / (truePositives + falseNegatives) : 0;
+    accuracy.f1 = (accuracy.precision + accuracy.recall > 0) ?
+                  2*accuracy.precision*accuracy.recall / (accuracy.precision + accuracy.recall) : 0;
+    return true;
+}
+
+/*
+ * Print the precision, recall and F1 score of the foreground of a mask against a ground truth
+ */
+static void ReportAccuracy(vil_image_view<unsigned char>& groundTruth, vil_image_view<unsigned char>& mask)
+{
+    Accuracy accuracy;
+    if (!MeasureAccuracy(groundTruth, mask, accuracy))
+    {
+        vcl_cout << "Ground truth is " << groundTruth.ni() << "x" << groundTruth.nj() << ", the frames are "
+                 << mask.ni() << "x" << mask.nj() << vcl_endl;
+        return;
+    }
+    vcl_cout << "TP " << accuracy.truePositives << " FP " << accuracy.falsePositives << " FN " << accuracy.falseNegatives
+             << " TN " << accuracy.trueNegatives << vcl_endl;
+    vcl_cout << "Precision " << accuracy.precision << " Recall " << accuracy.recall << " F1 " << accuracy.f1 << vcl_endl;
+}
+
+/// wall clock time in seconds, for throughput
+static double WallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ * One configuration of a parameter sweep, and how it did
+ */
+struct SweepPoint
+{
+    int radius;
+    int minSamples;
+    int subsampling;
+    int updateInterval;
+    bool measured;          // whether accuracy was measured (there is a ground truth for the frames)
+    Accuracy accuracy;
+    double seconds;         // time to train the model and segment every frame
+};
+
+/*
+ * Parse the values of a swept parameter, a comma separated list of values or first:last:step ranges (i.e. "1,2,4" or
+ * "10:30:5")
+ */
+static bool ParseSweepValues(const vcl_string& text, vcl_vector<int>& values)
+{
+    values.clear();
+    vcl_string::size_type start = 0;
+    while (start <= text.size())
+    {
+        vcl_string::size_type end = text.find(',', start);
+        end = (end == vcl_string::npos) ? text.size() : end;
+        int first; int last; int step = 1;
+        int fields = sscanf(text.substr(start, end - start).c_str(), "%d:%d:%d", &first, &last, &step);
+        if (fields == 1)
+        {
+            values.push_back(first);
+        }
+        else if ((fields >= 2) && (step > 0) && (last >= first))
+        {
+            for (int value = first; value <= last; value += step)
+            {
+                values.push_back(value);
+            }
+        }
+        else
+        {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+/*
+ * Parameter sweep, the frames are decoded once (and held in memory) and every combination of the swept parameters is
+ * run over them by its own model, the models in parallel. Each model is trained on the first NUM_TRAINING_IMAGES frames
+ * and otherwise has the settings of Settings. The accuracy of the mask of frame groundTruthIndex against the ground
+ * truth (if it exists), and the throughput of each configuration are printed, no masks are saved.
+ * spec - the parameters to sweep and their values, ; separated, i.e. "radius=10:30:5;min=1,2,3;subsampling=8,16;update=1"
+ *        (parameters that aren't given keep the value of Settings). The radius can't be swept with the chroma distance
+ */
+static int SegmentSweep(ViBe_Model& Settings, vcl_vector<vcl_string>& filenames, const vcl_string& spec,
+                        const vcl_string& groundTruthPath, unsigned groundTruthIndex)
+{
+    vcl_vector<int> radii(1, Settings.getRadius());
+    vcl_vector<int> minSamples(1, Settings.getMinSamplesBackground());
+    vcl_vector<int> subsamplings(1, Settings.getRandomSubsampling());
+    vcl_vector<int> intervals(1, Settings.getUpdateInterval());
+    vcl_string::size_type start = 0;
+    while (start < spec.size())
+    {
+        vcl_string::size_type end = spec.find(';', start);
+        end = (end == vcl_string::npos) ? spec.size() : end;
+        vcl_string item = spec.substr(start, end - start);
+        vcl_string::size_type equals = item.find('=');
+        vcl_string name = item.substr(0, equals);
+        vcl_vector<int>* values = (name == "radius") ? &radii : (name == "min") ? &minSamples :
+                                  (name == "subsampling") ? &subsamplings : (name == "update") ? &intervals : NULL;
+        if ((equals == vcl_string::npos) || (values == NULL) || !ParseSweepValues(item.substr(equals + 1), *values))
+        {
+            vcl_cout << "Can't sweep \"" << item << "\", give radius, min, subsampling or update = a list of values"
+                     << " or first:last:step ranges" << vcl_endl;
+            return 1;
+        }
+        start = end + 1;
+    }
+    /// the chroma distance has its own fixed thresholds, the radius doesn't change what it matches
+    if ((Settings.getDistanceMode() == DISTANCE_CHROMA) &&
+        ((radii.size() > 1) || (radii[0] != Settings.getRadius())))
+    {
+        vcl_cout << "Can't sweep radius with -distance chroma, it doesn't use the radius" << vcl_endl;
+        return 1;
+    }
+
+    vcl_vector<SweepPoint> points;
+    for (unsigned r = 0; r < radii.size(); r++)
+    for (unsigned m = 0; m < minSamples.size(); m++)
+    for (unsigned s = 0; s < subsamplings.size(); s++)
+    for (unsigned u = 0; u < intervals.size(); u++)
+    {
+        SweepPoint point;
+        point.radius = radii[r];
+        point.minSamples = minSamples[m];
+        point.subsampling = subsamplings[s];
+        point.updateInterval = intervals[u];
+        point.measured = false;
+        point.seconds = 0;
+        points.push_back(point);
+    }
+
+    /// every frame is decoded once, for all of the configurations
+    double started = WallTime();
+    int numFrames = filenames.size();
+    vcl_vector< vil_image_view<unsigned char> > frames(numFrames);
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < numFrames; t++)
+    {
+        frames[t] = vil_load(filenames[t].c_str());
+    }
+    for (int t = 0; t < numFrames; t++)
+    {
+        if (((int)frames[t].ni() != Settings.getWidth()) || ((int)frames[t].nj() != Settings.getHeight()))
+        {
+            vcl_cout << filenames[t] << " can't be loaded or is not the size of the first frame" << vcl_endl;
+            return 1;
+        }
+    }
+    double decodeSeconds = WallTime() - started;
+
+    vil_image_view<unsigned char> groundTruth;
+    if ((groundTruthIndex < frames.size()) && vul_file::exists(groundTruthPath))
+    {
+        groundTruth = vil_load(groundTruthPath.c_str());
+    }
+    vcl_vector< vil_image_view<unsigned char> > trainingImages(frames.begin(),
+                                                               frames.begin() + vcl_min(numFrames, NUM_TRAINING_IMAGES));
+
+    /// one configuration per thread at a time, each model is freed when its configuration is done, so only as many
+    /// models as threads are held at once (on top of the decoded frames)
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int p = 0; p < (int)points.size(); p++)
+    {
+        SweepPoint& point = points[p];
+        double pointStarted = WallTime();
+        ViBe_Model Model;
+        Model.Init(NUM_SAMPLES, point.radius, point.minSamples, point.subsampling, Settings.getWidth(),
+                   Settings.getHeight());
+        Model.CopySettings(Settings);
+        Model.SetRandomSubsampling(point.subsampling);
+        Model.SetUpdateInterval(point.updateInterval);
+        Model.InitBackground(trainingImages);
+
+        vil_image_view<unsigned char> resultImage(Settings.getWidth(), Settings.getHeight(), 1);
+        for (int t = 0; t < numFrames; t++)
+        {
+            Model.Segment(frames[t], resultImage);
+            if ((t == (int)groundTruthIndex) && (groundTruth.size() > 0))
+            {
+                point.measured = MeasureAccuracy(groundTruth, resultImage, point.accuracy);
+            }
+        }
+        point.seconds = WallTime() - pointStarted;
+    }
+    double totalSeconds = WallTime() - started;
+
+    vcl_cout << points.size() << " configurations over " << numFrames << " frames, decoded once in " << decodeSeconds
+             << " s" << vcl_endl;
+    vcl_cout << "radius\tmin\tsubsampling\tupdate\tprecision\trecall\tF1\tframes/s" << vcl_endl;
+    int best = -1;
+    for (unsigned p = 0; p < points.size(); p++)
+    {
+        SweepPoint& point = points[p];
+        vcl_cout << point.radius << "\t" << point.minSamples << "\t" << point.subsampling << "\t" << point.updateInterval;
+        if (point.measured)
+        {
+            vcl_cout << "\t" << point.accuracy.precision << "\t" << point.accuracy.recall << "\t" << point.accuracy.f1;
+            best = ((best < 0) || (point.accuracy.f1 > points[best].accuracy.f1)) ? p : best;
+        }
+        else
+        {
+            vcl_cout << "\t-\t-\t-";
+        }
+        vcl_cout << "\t" << ((point.seconds > 0) ? numFrames / point.seconds : 0) << vcl_endl;
+    }
+    if (best >= 0)
+    {
+        vcl_cout << "Best F1 " << points[best].accuracy.f1 << " with radius " << points[best].radius << " min "
+                 << points[best].minSamples << " subsampling " << points[best].subsampling << " update "
+                 << points[best].updateInterval << vcl_endl;
+    }
+    else
+    {
+        vcl_cout << "No ground truth at " << groundTruthPath << " for frame " << groundTruthIndex
+                 << ", accuracy not measured" << vcl_endl;
+    }
+    vcl_cout << "Total " << totalSeconds << " s, " << (numFrames * points.size()) / totalSeconds
+             << " frames/s over all configurations" << vcl_endl;
+    return 0;
+}
+
 /*
  * Main program to run the ViBe motion detection algorithm.
  * This program will
@@ -61,6 +871,88 @@ int main (int argc, char * argv[])
 	/// finally, we have some floats
 	vul_arg<float> arg_float("-f", "A float", 4.0);
 
+	/// streaming input, frames are read from stdin or a named pipe as they arrive instead of from a directory
+	vul_arg<vcl_string>
+		arg_stream("-stream", "Input stream, a y4m or raw RGB file or pipe, - for stdin", ""),
+		arg_stream_out("-stream_out", "Output stream for the masks of -stream, - for stdout", "-");
+	/// allocation free frame loop, and a check that it really doesn't allocate after the given number of frames
+	vul_arg<bool> arg_steady("-steady", "Allocation free frame loop, masks are saved as PGM", false);
+	vul_arg<unsigned> arg_alloc_check("-alloc_check", "With -steady, fail on any heap allocation after this many frames (0 to disable)", 0);
+
+	/// temporal decimation, classify every frame but only update the model every k'th frame
+	vul_arg<unsigned> arg_update_every("-update_every", "Update the model on every k'th frame only, at a raised rate", 1);
+
+	/// how pixels are compared to the background samples
+	/// ground truth, to measure the accuracy of the segmentation (i.e. of the approximate modes)
+	vul_arg<vcl_string> arg_gt("-gt", "Ground truth image, non zero pixels are foreground", "");
+	vul_arg<unsigned> arg_gt_index("-gt_index", "Index of the input frame the ground truth is for", 0);
+
+	/// approximate matching, only compare a rotating subset of the samples each frame
+	vul_arg<unsigned> arg_approx("-approx", "Compare only this many samples per frame, borderline pixels compare all (0 for all)", 0);
+
+	/// checkerboard classification, half of the pixels per frame
+	vul_arg<bool> arg_checkerboard("-checkerboard", "Classify half of the pixels each frame in an alternating checkerboard, filling in the rest", false);
+
+	/// offline re-analysis, split the recording into chunks that are segmented in parallel
+	vul_arg<unsigned> arg_chunks("-chunks", "Split the frames into this many chunks, segmented in parallel by separate models", 1),
+		arg_overlap("-overlap", "Frames before each chunk that its model is trained and warmed up on", 50);
+
+	/// wavefront scheduling, bands of several frames segmented at once
+	vul_arg<unsigned> arg_wavefront("-wavefront", "Segment in this many row bands with several frames in flight (0 for the normal frame loop)", 0),
+		arg_wavefront_frames("-wavefront_frames", "Frames in flight per batch with -wavefront", 8);
+
+	/// frame manifest, an index of a huge directory that is listed once and reused, and the range of frames to segment
+	vul_arg<vcl_string> arg_manifest("-manifest", "Frame manifest of the directory, built (by listing it) if it doesn't exist", "");
+	vul_arg<bool> arg_manifest_rebuild("-manifest_rebuild", "List the directory again and rewrite the -manifest", false);
+	vul_arg<int> arg_first_frame("-first_frame", "With -manifest, the frame number to start from", 0),
+		arg_last_frame("-last_frame", "With -manifest, the last frame number to segment (-1 for all)", -1);
+
+	/// read the files of the next frames ahead of decoding, in batches
+	vul_arg<unsigned> arg_prefetch("-prefetch", "With -steady, -fused or the reduced modes, read the files ahead on a reader thread in batches of this many (0 to disable)", 0);
+
+	/// parameter sweep, every configuration run over frames decoded once
+	vul_arg<vcl_string> arg_sweep("-sweep", "Sweep the parameters over the frames instead of saving masks, i.e. radius=10:30:5;min=1,2,3;subsampling=8,16;update=1 (accuracy against -gt, or groundtruth.bmp in -path, at -gt_index)", "");
+
+	/// follow mode, keep segmenting the frames written into the directory by a live camera
+	vul_arg<bool> arg_follow("-follow", "Keep watching the directory and segment new frames as they are written (Linux only)", false);
+	vul_arg<unsigned> arg_follow_backlog("-follow_backlog", "Most frames waiting to be segmented with -follow, older ones are dropped", FOLLOW_BACKLOG),
+		arg_follow_reorder("-follow_reorder", "Frames held back with -follow to put frames that arrive out of order in order", FOLLOW_REORDER);
+
+	/// model bank, for cameras that switch between scenes (PTZ presets, day and night)
+	vul_arg<unsigned> arg_bank("-bank", "Keep the backgrounds of up to this many scenes, swapping the closest in when the scene switches (0 to disable)", 0);
+	vul_arg<float> arg_bank_switch("-bank_switch", "Fingerprint distance (0 - 255) from the current scene that is a scene switch", BANK_SWITCH_DISTANCE),
+		arg_bank_match("-bank_match", "Fingerprint distance (0 - 255) to a stored scene close enough to swap it in", BANK_MATCH_DISTANCE);
+
+	/// fused decoding and segmentation, a group of rows at a time
+	vul_arg<bool> arg_fused("-fused", "Segment each frame's rows as they are decoded, without decoding the whole frame first", false);
+
+	/// reduced decoding, for when full resolution colour isn't needed
+	vul_arg<unsigned> arg_scale("-scale", "Decode JPEGs at 1/scale of their size (1, 2, 4 or 8)", 1);
+	vul_arg<bool> arg_gray("-gray", "Decode only the luma of JPEGs", false);
+	vul_arg<vcl_string> arg_roi("-roi", "Only decode and segment this region of JPEGs, x,y,width,height in full size pixels", "");
+
+	vul_arg<vcl_string> arg_distance("-distance", "Pixel distance, rgb (euclidean) or chroma (chromaticity and brightness)", "rgb");
+	vul_arg<bool> arg_packed("-packed", "With rgb distance, keep the samples in one cache line aligned array (same result, SIMD in the ReleaseAVX2 target)", false);
+	vul_arg<bool> arg_sorted("-sorted", "With rgb distance, only compare samples close in intensity (same result, fewer comparisons)", false);
+	vul_arg<bool> arg_envelope("-envelope", "With rgb distance, reject pixels outside the per channel range of their samples before comparing (same result)", false);
+
+	/// what to do when a lighting change floods the frame with foreground
+	vul_arg<vcl_string> arg_illumination("-illumination", "Lighting change handling, off, update (fast model update) or reseed", "off");
+	vul_arg<float> arg_illumination_threshold("-illumination_threshold", "Foreground fraction of a frame that may be a lighting change", ILLUMINATION_THRESHOLD);
+
+	/// compensate for camera shake by shifting the model lookups
+	vul_arg<unsigned> arg_jitter("-jitter", "Largest camera jitter to compensate for, in pixels (0 disables)", 0);
+
+	/// model checkpoints, written periodically so a standby process can take over the model, and restored at startup
+	vul_arg<vcl_string>
+		arg_checkpoint_dir("-checkpoint_dir", "Write model checkpoints to this directory", ""),
+		arg_restore_dir("-restore_dir", "Start from the latest checkpoint in this directory instead of training", "");
+	vul_arg<unsigned> arg_checkpoint_every("-checkpoint_every", "Frames between checkpoints", 25),
+		arg_checkpoint_full_every("-checkpoint_full_every", "Checkpoints between full (non delta) checkpoints", 20);
+
+	vul_arg<unsigned> arg_width("-width", "Width of a raw RGB stream, leave as 0 for y4m", 0),
+		arg_height("-height", "Height of a raw RGB stream, leave as 0 for y4m", 0);
+
 	/// call vul_arg_parse(argc, argv) to parse the arguments, this will go through the command line string, look for all the specified argument string,
 	/// and extract the provided values.
 	vul_arg_parse(argc, argv);
@@ -75,13 +967,101 @@ int main (int argc, char * argv[])
 	///
 	/// we can use this to check that required variables were provided
 	/// if arg_in_path() or arg_in_glob() are empty strings, it means they weren't provided
-	if (((arg_in_path() == "") || (arg_in_glob() == "")))
+	if ((arg_stream() == "") && ((arg_in_path() == "") || (arg_in_glob() == "")))
 	{
 		/// if we need these arguments to proceed, we can now exit and print the help as we quit. vul_arg_display_usage_and_exit() will display the available arguments
 		/// alongside the help message specified when the vul_arg objects were created
 		vul_arg_display_usage_and_exit();
 	}
 
+    ModelOptions options;
+    options.updateEvery = arg_update_every();
+    options.sorted = arg_sorted();
+    options.envelope = arg_envelope();
+    options.packed = arg_packed();
+    options.approximate = arg_approx();
+    options.checkerboard = arg_checkerboard();
+    options.illuminationThreshold = arg_illumination_threshold();
+    options.jitter = arg_jitter();
+    if ((arg_distance() != "rgb") && (arg_distance() != "chroma"))
+    {
+        vcl_cout << "-distance should be rgb or chroma" << vcl_endl;
+        return 1;
+    }
+    options.distanceMode = (arg_distance() == "chroma") ? DISTANCE_CHROMA : DISTANCE_RGB;
+    /// frames decoded with -gray have no colour, so every pixel would have the same chromaticity as its samples
+    if ((options.distanceMode == DISTANCE_CHROMA) && arg_gray())
+    {
+        vcl_cout << "-distance chroma can't be used with -gray, the frames have no colour" << vcl_endl;
+        return 1;
+    }
+    if ((arg_illumination() != "off") && (arg_illumination() != "update") && (arg_illumination() != "reseed"))
+    {
+        vcl_cout << "-illumination should be off, update or reseed" << vcl_endl;
+        return 1;
+    }
+    options.illuminationMode = (arg_illumination() == "update") ? ILLUMINATION_FAST_UPDATE :
+                               (arg_illumination() == "reseed") ? ILLUMINATION_RESEED : ILLUMINATION_OFF;
+
+    /// the frame loop to use, in order of precedence, and the flags only some of the loops honour
+    bool reducedDecoding = (arg_scale() > 1) || arg_gray() || (arg_roi() != "");
+    int loop = (arg_stream() != "") ? LOOP_STREAM : (arg_sweep() != "") ? LOOP_SWEEP : (arg_chunks() > 1) ? LOOP_CHUNKS :
+               arg_follow() ? LOOP_FOLLOW : (arg_wavefront() > 0) ? LOOP_WAVEFRONT : arg_fused() ? LOOP_FUSED :
+               (arg_steady() || reducedDecoding) ? LOOP_STEADY : LOOP_NORMAL;
+    const char* loopName = (loop == LOOP_STREAM) ? "-stream" : (loop == LOOP_SWEEP) ? "-sweep" :
+                           (loop == LOOP_CHUNKS) ? "-chunks" : (loop == LOOP_FOLLOW) ? "-follow" :
+                           (loop == LOOP_WAVEFRONT) ? "-wavefront" : (loop == LOOP_FUSED) ? "-fused" :
+                           (loop == LOOP_STEADY) ? "the steady state frame loop" : "the normal frame loop";
+    const int directoryLoops = LOOP_SWEEP | LOOP_CHUNKS | LOOP_FOLLOW | LOOP_WAVEFRONT | LOOP_FUSED | LOOP_STEADY | LOOP_NORMAL;
+    /// segmenting in bands only looks at the neighbouring rows, see ViBe_Model::canSegmentBands
+    const int wholeFrameLoops = LOOP_STREAM | LOOP_SWEEP | LOOP_CHUNKS | LOOP_FOLLOW | LOOP_STEADY | LOOP_NORMAL;
+    bool frameRange = (arg_first_frame() != 0) || (arg_last_frame() != -1);
+    const LoopFlag loopFlags[] =
+    {
+        { "-stream", arg_stream() != "", LOOP_STREAM },
+        { "-sweep", arg_sweep() != "", LOOP_SWEEP },
+        { "-chunks", arg_chunks() > 1, LOOP_CHUNKS },
+        { "-follow", arg_follow(), LOOP_FOLLOW },
+        { "-wavefront", arg_wavefront() > 0, LOOP_WAVEFRONT },
+        { "-fused", arg_fused(), LOOP_FUSED },
+        { "-steady", arg_steady(), LOOP_STEADY },
+        { "-alloc_check", arg_alloc_check() > 0, LOOP_STEADY },
+        { "-scale, -gray or -roi", reducedDecoding, LOOP_FOLLOW | LOOP_FUSED | LOOP_STEADY },
+        { "-prefetch", arg_prefetch() > 0, LOOP_FUSED | LOOP_STEADY },
+        { "-manifest", arg_manifest() != "", directoryLoops },
+        { "-first_frame or -last_frame", frameRange, directoryLoops },
+        { "-checkpoint_dir", arg_checkpoint_dir() != "", LOOP_FOLLOW | LOOP_STEADY | LOOP_NORMAL },
+        { "-restore_dir", arg_restore_dir() != "", LOOP_FOLLOW | LOOP_WAVEFRONT | LOOP_FUSED | LOOP_STEADY | LOOP_NORMAL },
+        { "-bank", arg_bank() > 0, LOOP_FOLLOW | LOOP_STEADY | LOOP_NORMAL },
+        { "-gt", arg_gt() != "", LOOP_SWEEP | LOOP_NORMAL },
+        { "-checkerboard", arg_checkerboard(), wholeFrameLoops },
+        { "-illumination", options.illuminationMode != ILLUMINATION_OFF, wholeFrameLoops },
+        { "-jitter", arg_jitter() > 0, wholeFrameLoops },
+        { "-width or -height", (arg_width() > 0) || (arg_height() > 0), LOOP_STREAM },
+        { "-stream_out", arg_stream_out() != "-", LOOP_STREAM }
+    };
+    if (!CheckLoopFlags(loop, loopName, loopFlags, sizeof(loopFlags) / sizeof(loopFlags[0])))
+    {
+        return 1;
+    }
+    /// the range is looked up in the manifest, a plain listing of the directory has no frame numbers to go by
+    if (frameRange && (arg_manifest() == ""))
+    {
+        vcl_cout << "-first_frame and -last_frame are only used with -manifest" << vcl_endl;
+        return 1;
+    }
+    /// only JPEGs are decoded reduced, any other frame would be loaded at full size and not fit the model
+    if (reducedDecoding && !HasJpegExtension(arg_in_glob()))
+    {
+        vcl_cout << "-scale, -gray and -roi only apply to JPEG frames, -glob should end in jpg, jpeg or jpe"
+                 << vcl_endl;
+        return 1;
+    }
+
+	if (arg_stream() != "")
+	{
+		return SegmentStream(arg_stream(), arg_stream_out(), arg_width(), arg_height(), options);
+	}
 
 	/// Parsing a directory of images
 	/// this is a list to store our filenames in
@@ -91,6 +1071,42 @@ int main (int argc, char * argv[])
 	vcl_string directory = arg_in_path();
 	vcl_string extension = arg_in_glob();
 
+    /// to follow the directory it's watched before it's listed, so no frame can slip in between
+    /// (new files are matched on what follows the leading *'s of the glob)
+    ViBe_DirectoryWatcher watcher;
+    vcl_string suffix = extension;
+    suffix.erase(0, suffix.find_first_not_of('*'));
+    if (arg_follow() && !watcher.Open(directory, suffix, arg_follow_backlog(), arg_follow_reorder()))
+    {
+        vcl_cout << "Unable to watch " << directory << vcl_endl;
+        return 1;
+    }
+
+    ViBe_FrameManifest manifest;
+    if (arg_manifest() != "")
+    {
+        /// the manifest gives the frames in order of frame number, only the range asked for is read
+        if (arg_manifest_rebuild() || !manifest.Open(arg_manifest(), directory))
+        {
+            if (!manifest.Build(directory, extension))
+            {
+                vcl_cout << "Unable to build a manifest of " << directory << ", it has no numbered frames or frame "
+                         << "numbers too large for the manifest (above 4294967295, i.e. timestamps)" << vcl_endl;
+                return 1;
+            }
+            if (!manifest.Save(arg_manifest()))
+            {
+                vcl_cout << "Unable to write the manifest " << arg_manifest() << vcl_endl;
+            }
+        }
+        if (!manifest.GetRange(arg_first_frame(), arg_last_frame(), filenames))
+        {
+            vcl_cout << "Unable to read the manifest " << arg_manifest() << vcl_endl;
+            return 1;
+        }
+    }
+    else
+    {
 	/// loop through a directory using a vul_file_iterator, this will create a list of all files that match "directory + "/*" + extension", i.e. all files in the directory
 	/// that have our target extension
 	for (vul_file_iterator fn=(directory + "/*" + extension); fn; ++fn)
@@ -102,6 +1118,27 @@ int main (int argc, char * argv[])
 			filenames.push_back (fn());
 		}
 	}
+    }
+
+    if (arg_follow())
+    {
+        /// the model is trained on the latest frames already there, waiting for more if there aren't enough
+        vcl_sort(filenames.begin(), filenames.end(), EarlierFrame);
+        if (filenames.size() > NUM_TRAINING_IMAGES)
+        {
+            filenames.erase(filenames.begin(), filenames.end() - NUM_TRAINING_IMAGES);
+        }
+        if (!filenames.empty())
+        {
+            watcher.SetLastFrame(ViBe_DirectoryWatcher::FrameNumber(filenames.back()));
+        }
+        vcl_string filename;
+        long frameNumber;
+        while ((filenames.size() < NUM_TRAINING_IMAGES) && watcher.Next(filename, frameNumber))
+        {
+            filenames.push_back(filename);
+        }
+    }
 
 	if (filenames.size() == 0)
     {
@@ -109,13 +1146,117 @@ int main (int argc, char * argv[])
         return 0;
     }
 
-    vil_image_view<unsigned char> anImage = vil_load(filenames[0].c_str());
+    /// with reduced (or cropped) decoding every frame goes through the frame decoder, including the training frames, and the frame
+    /// loop is the steady state one (or the fused one)
+    ViBe_FrameDecoder decoder;
+    decoder.SetScale(arg_scale());
+    decoder.SetGrayscale(arg_gray());
+    bool reduced = (decoder.getScale() > 1) || decoder.isGrayscale();
+    if (arg_roi() != "")
+    {
+        int x; int y; int w; int h;
+        if (sscanf(arg_roi().c_str(), "%d,%d,%d,%d", &x, &y, &w, &h) != 4)
+        {
+            vcl_cout << "-roi should be x,y,width,height" << vcl_endl;
+            return 1;
+        }
+        /// the model covers just the region
+        decoder.SetCrop(x, y, w, h);
+        reduced = true;
+    }
+
+    vil_image_view<unsigned char> anImage;
+    if (reduced && decoder.DecodeFile(filenames[0].c_str()))
+    {
+        anImage = decoder.getImage();
+    }
+    else
+    {
+        anImage = vil_load(filenames[0].c_str());
+    }
 
     ViBe_Model Model;
     Model.Init(NUM_SAMPLES, RADIUS, MINSAMPLES, SUBSAMPLING, anImage.ni(), anImage.nj());
+    ApplyModelOptions(Model, options);
+
+    if (loop == LOOP_SWEEP)
+    {
+        return SegmentSweep(Model, filenames, arg_sweep(), (arg_gt() != "") ? arg_gt() : directory + "/groundtruth.bmp",
+                            arg_gt_index());
+    }
+
+    if (loop == LOOP_CHUNKS)
+    {
+        return SegmentChunks(Model, filenames, arg_chunks(), arg_overlap());
+    }
+
+    bool restored = false;
+    if (arg_restore_dir() != "")
+    {
+        /// fail over, take the model from the checkpoints of another process rather than learning it again
+        ViBe_CheckpointReader checkpointReader;
+        checkpointReader.Open(arg_restore_dir());
+        restored = checkpointReader.Poll(Model) > 0;
+        if (!restored)
+        {
+            vcl_cout << "No usable checkpoint in " << arg_restore_dir() << ", training the model instead." << vcl_endl;
+        }
+    }
+    if (!restored && reduced)
+    {
+        TrainFromDecoder(Model, decoder, filenames);
+    }
+    else if (!restored)
+    {
+        Model.InitBackground(NUM_TRAINING_IMAGES, filenames);
+    }
+
+    ViBe_CheckpointWriter checkpointWriter;
+    ViBe_CheckpointWriter* checkpoints = NULL;
+    unsigned checkpointEvery = (arg_checkpoint_every() > 0) ? arg_checkpoint_every() : 1;
+    if (arg_checkpoint_dir() != "")
+    {
+        checkpointWriter.Open(arg_checkpoint_dir(), arg_checkpoint_full_every());
+        checkpoints = &checkpointWriter;
+        /// so delta checkpoints only need to look at the pixels that changed
+        Model.EnableDirtyTracking(true);
+    }
+
+    ViBe_ModelBank modelBank;
+    ViBe_ModelBank* bank = NULL;
+    if (arg_bank() > 0)
+    {
+        modelBank.Init(Model, arg_bank(), arg_bank_switch(), arg_bank_match());
+        bank = &modelBank;
+    }
+
+    if (loop == LOOP_FOLLOW)
+    {
+        return SegmentFollow(Model, decoder, watcher, checkpoints, checkpointEvery, bank);
+    }
+
+    if (loop == LOOP_WAVEFRONT)
+    {
+        return SegmentWavefront(Model, filenames, arg_wavefront(), arg_wavefront_frames());
+    }
 
-    Model.InitBackground(NUM_TRAINING_IMAGES, filenames);
+    ViBe_FramePrefetcher prefetcher;
+    ViBe_FramePrefetcher* prefetch = NULL;
+    if (arg_prefetch() > 0)
+    {
+        prefetcher.Start(filenames, arg_prefetch());
+        prefetch = &prefetcher;
+    }
+
+    if (loop == LOOP_FUSED)
+    {
+        return SegmentFused(Model, decoder, filenames, prefetch);
+    }
 
+    if (loop == LOOP_STEADY)
+    {
+        return SegmentSteady(Model, decoder, filenames, arg_alloc_check(), checkpoints, checkpointEvery, prefetch, bank);
+    }
 
 
 	/// filenames now contain all of the files with our target extension in our directory, if we want to loop through them, we can now do
@@ -126,14 +1267,30 @@ int main (int argc, char * argv[])
 		/// do something with filenames[i]
 		/// if filenames[i] is an image, we might want to load it, so we could do:
 		vil_image_view<unsigned char> srcImage = vil_load(filenames[i].c_str());
+        if (!FitsModel(Model, srcImage, filenames[i]))
+        {
+            continue;
+        }
         vil_image_view<unsigned char> resultImage( srcImage.ni(), srcImage.nj(), 1);
 
+        UpdateBank(bank, srcImage, i);
         Model.Segment(srcImage, resultImage);
 
 		vcl_stringstream outputFilename;
         outputFilename << "output/" << "BackgroundSegmentation_" << i << ".png";
         vil_save(resultImage, outputFilename.str().c_str());
 
+        if ((arg_gt() != "") && (i == (int)arg_gt_index()))
+        {
+            vil_image_view<unsigned char> groundTruth = vil_load(arg_gt().c_str());
+            ReportAccuracy(groundTruth, resultImage);
+        }
+
+        if ((checkpoints != NULL) && ((i + 1) % checkpointEvery == 0))
+        {
+            checkpoints->Write(Model, i);
+        }
+
 		// we could now do other things with this file, such as run it through a motion segmentation algorithm
 	}
 }
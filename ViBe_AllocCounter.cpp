@@ -0,0 +1,80 @@
+#include "ViBe_AllocCounter.h"
+
+#include <new>
+
+#ifndef _STDLIB_
+#define _STDLIB_
+#include <stdlib.h>
+#endif
+
+unsigned long ViBe_AllocCounter::count = 0;
+bool ViBe_AllocCounter::counting = false;
+
+void ViBe_AllocCounter::Record()
+{
+    if (counting)
+    {
+        #pragma omp atomic
+        count++;
+    }
+}
+
+void ViBe_AllocCounter::Reset()
+{
+    count = 0;
+    counting = true;
+}
+
+unsigned long ViBe_AllocCounter::getCount()
+{
+    return count;
+}
+
+/// replacements for the global allocation functions, these only add the counter to the default behaviour
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    ViBe_AllocCounter::Record();
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    ViBe_AllocCounter::Record();
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    ViBe_AllocCounter::Record();
+    return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* memory) throw()
+{
+    free(memory);
+}
+
+void operator delete[](void* memory) throw()
+{
+    free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) throw()
+{
+    free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) throw()
+{
+    free(memory);
+}
@@ -0,0 +1,25 @@
+#ifndef __VIBE_ALLOC_COUNTER_H__
+#define __VIBE_ALLOC_COUNTER_H__
+
+/*
+ * Test hook that counts heap allocations, used to enforce that the steady state frame loop doesn't allocate.
+ * ViBe_AllocCounter.cpp replaces the global operator new/new[] (and delete) so every C++ allocation in the program can
+ * be recorded. The replacement is always active in the executables ViBe_AllocCounter.cpp is linked into (the command
+ * line targets, never the SharedLib target, where it would replace the host program's allocator), but it only
+ * forwards to malloc and free until counting is started by the first Reset(), which only -alloc_check calls.
+ * Allocations made through other allocators that we control (i.e. the JPEG decoder's memory pool) call Record()
+ * themselves.
+ */
+class ViBe_AllocCounter
+{
+public:
+    static void Record();
+    static void Reset();
+    static unsigned long getCount();
+
+private:
+    static unsigned long count;
+    static bool counting;
+};
+
+#endif
@@ -0,0 +1,344 @@
+#include "ViBe_C.h"
+
+#include <vil/vil_image_view.h>
+
+#include "ViBe_Model.h"
+#include "ViBe_Checkpoint.h"
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+#ifndef _STRING_
+#define _STRING_
+#include <string.h>
+#endif
+
+/// snapshot header, little endian 32 bit words: magic, version, width, height, samples per pixel, raw size,
+/// compressed size, adler32 of the raw samples
+#define SNAPSHOT_MAGIC 0x534E4256     // "VBNS"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_WORDS 8
+
+struct vibe_model
+{
+    ViBe_Model model;
+    bool trained;
+    int illuminationMode;           // kept so the mode and threshold can be set separately
+    double illuminationThreshold;
+    vcl_vector<unsigned char> samples;
+    vcl_vector<unsigned char> compressed;
+};
+
+static unsigned long read32(const unsigned char* p)
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void write32(unsigned char* p, unsigned long value)
+{
+    p[0] = (unsigned char)(value & 0xFF);
+    p[1] = (unsigned char)((value >> 8) & 0xFF);
+    p[2] = (unsigned char)((value >> 16) & 0xFF);
+    p[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+/// no exception may cross into the caller's language, every entry point catches them and returns an error instead
+
+vibe_model* vibe_create(int width, int height)
+{
+    if ((width <= 0) || (height <= 0))
+    {
+        return NULL;
+    }
+    try
+    {
+        vibe_model* handle = new vibe_model;
+        handle->trained = false;
+        handle->illuminationMode = ILLUMINATION_OFF;
+        handle->illuminationThreshold = ILLUMINATION_THRESHOLD;
+        handle->model.Init(NUM_SAMPLES, RADIUS, MINSAMPLES, SUBSAMPLING, width, height);
+        return handle;
+    }
+    catch (...)
+    {
+        return NULL;
+    }
+}
+
+void vibe_destroy(vibe_model* model)
+{
+    delete model;
+}
+
+int vibe_set_param(vibe_model* model, int param, double value)
+{
+    if (model == NULL)
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    ViBe_Model& Model = model->model;
+    switch (param)
+    {
+    case VIBE_PARAM_SUBSAMPLING:
+        if (value < 1)
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        Model.SetRandomSubsampling((int)value);
+        break;
+    case VIBE_PARAM_UPDATE_INTERVAL:
+        if (value < 1)
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        Model.SetUpdateInterval((int)value);
+        break;
+    case VIBE_PARAM_DISTANCE_MODE:
+        if (((int)value != DISTANCE_RGB) && ((int)value != DISTANCE_CHROMA))
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        Model.SetDistanceMode((int)value);
+        break;
+    case VIBE_PARAM_ILLUMINATION_MODE:
+        if (((int)value < ILLUMINATION_OFF) || ((int)value > ILLUMINATION_RESEED))
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        model->illuminationMode = (int)value;
+        Model.SetIlluminationAdaptation(model->illuminationMode, model->illuminationThreshold, ILLUMINATION_FRAMES);
+        break;
+    case VIBE_PARAM_ILLUMINATION_THRESHOLD:
+        if ((value <= 0) || (value > 1))
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        model->illuminationThreshold = value;
+        Model.SetIlluminationAdaptation(model->illuminationMode, model->illuminationThreshold, ILLUMINATION_FRAMES);
+        break;
+    case VIBE_PARAM_JITTER_MAX_SHIFT:
+        if (value < 0)
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        Model.SetJitterCompensation((int)value);
+        break;
+    case VIBE_PARAM_DIRTY_TRACKING:
+        try
+        {
+            Model.EnableDirtyTracking(value != 0);
+        }
+        catch (...)
+        {
+            return VIBE_ERROR_MEMORY;
+        }
+        break;
+    case VIBE_PARAM_SORTED_MATCHING:
+        Model.SetSortedMatching(value != 0);
+        break;
+    case VIBE_PARAM_ENVELOPE_REJECTION:
+        Model.SetEnvelopeRejection(value != 0);
+        break;
+    case VIBE_PARAM_PACKED_MATCHING:
+        try
+        {
+            Model.SetPackedMatching(value != 0);
+        }
+        catch (...)
+        {
+            return VIBE_ERROR_MEMORY;
+        }
+        break;
+    case VIBE_PARAM_APPROXIMATE_SAMPLES:
+        if ((value < 0) || (value >= NUM_SAMPLES))
+        {
+            return VIBE_ERROR_ARGUMENT;
+        }
+        Model.SetApproximateMatching((int)value);
+        break;
+    case VIBE_PARAM_CHECKERBOARD:
+        try
+        {
+            Model.SetCheckerboard(value != 0);
+        }
+        catch (...)
+        {
+            return VIBE_ERROR_MEMORY;
+        }
+        break;
+    default:
+        return VIBE_ERROR_ARGUMENT;
+    }
+    return VIBE_OK;
+}
+
+int vibe_train(vibe_model* model, const unsigned char* const* frames, int num_frames, int stride)
+{
+    if ((model == NULL) || (frames == NULL) || (num_frames <= 0))
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    ViBe_Model& Model = model->model;
+    int width = Model.getWidth();
+    int height = Model.getHeight();
+    if (stride < width*3)
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    try
+    {
+        /// the caller's buffers are wrapped rather than copied
+        vcl_vector< vil_image_view<unsigned char> > trainingImages(num_frames);
+        for (int n=0; n<num_frames; n++)
+        {
+            if (frames[n] == NULL)
+            {
+                return VIBE_ERROR_ARGUMENT;
+            }
+            trainingImages[n] = vil_image_view<unsigned char>(const_cast<unsigned char*>(frames[n]), width, height,
+                                                              3, 3, stride, 1);
+        }
+        Model.InitBackground(trainingImages);
+    }
+    catch (...)
+    {
+        return VIBE_ERROR_MEMORY;
+    }
+    model->trained = true;
+    return VIBE_OK;
+}
+
+int vibe_segment(vibe_model* model, const unsigned char* frame, int stride, unsigned char* mask, int mask_stride)
+{
+    if ((model == NULL) || (frame == NULL) || (mask == NULL))
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    if (!model->trained)
+    {
+        return VIBE_ERROR_STATE;
+    }
+    ViBe_Model& Model = model->model;
+    int width = Model.getWidth();
+    int height = Model.getHeight();
+    if ((stride < width*3) || (mask_stride < width))
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    try
+    {
+        vil_image_view<unsigned char> input(const_cast<unsigned char*>(frame), width, height, 3, 3, stride, 1);
+        vil_image_view<unsigned char> output(mask, width, height, 1, 1, mask_stride, width*height);
+        Model.Segment(input, output);
+    }
+    catch (...)
+    {
+        return VIBE_ERROR_MEMORY;
+    }
+    return Model.getForegroundCount();
+}
+
+long vibe_snapshot(vibe_model* model, unsigned char* buffer, size_t capacity)
+{
+    if (model == NULL)
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    if (!model->trained)
+    {
+        return VIBE_ERROR_STATE;
+    }
+    ViBe_Model& Model = model->model;
+    unsigned long size;
+    try
+    {
+        Model.ExportSamples(model->samples);
+        ViBe_LZ::Compress(&model->samples[0], model->samples.size(), model->compressed);
+        size = SNAPSHOT_HEADER_WORDS*4 + model->compressed.size();
+    }
+    catch (...)
+    {
+        return VIBE_ERROR_MEMORY;
+    }
+    if ((buffer == NULL) || (capacity < size))
+    {
+        return (long)size;
+    }
+
+    write32(buffer, SNAPSHOT_MAGIC);
+    write32(buffer + 4, SNAPSHOT_VERSION);
+    write32(buffer + 8, Model.getWidth());
+    write32(buffer + 12, Model.getHeight());
+    write32(buffer + 16, Model.getNumSamples());
+    write32(buffer + 20, model->samples.size());
+    write32(buffer + 24, model->compressed.size());
+    write32(buffer + 28, ViBe_LZ::Adler32(&model->samples[0], model->samples.size()));
+    if (!model->compressed.empty())
+    {
+        memcpy(buffer + SNAPSHOT_HEADER_WORDS*4, &model->compressed[0], model->compressed.size());
+    }
+    if (Model.isDirtyTrackingEnabled())
+    {
+        Model.ClearDirty();
+    }
+    return (long)size;
+}
+
+int vibe_restore(vibe_model* model, const unsigned char* snapshot, size_t size)
+{
+    if ((model == NULL) || (snapshot == NULL))
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    if (size < SNAPSHOT_HEADER_WORDS*4)
+    {
+        return VIBE_ERROR_DATA;
+    }
+    ViBe_Model& Model = model->model;
+    unsigned long rawSize = read32(snapshot + 20);
+    unsigned long compressedSize = read32(snapshot + 24);
+    int numSamples = (int)read32(snapshot + 16);
+    if ((read32(snapshot) != SNAPSHOT_MAGIC) || (read32(snapshot + 4) != SNAPSHOT_VERSION) ||
+        ((int)read32(snapshot + 8) != Model.getWidth()) || ((int)read32(snapshot + 12) != Model.getHeight()) ||
+        (rawSize != (unsigned long)(Model.getWidth()*Model.getHeight()*NUM_SAMPLES*3)) ||
+        (compressedSize != size - SNAPSHOT_HEADER_WORDS*4) || (numSamples < 1) || (numSamples > NUM_SAMPLES))
+    {
+        return VIBE_ERROR_DATA;
+    }
+    try
+    {
+        model->samples.resize(rawSize);
+        if (!ViBe_LZ::Decompress(snapshot + SNAPSHOT_HEADER_WORDS*4, compressedSize, &model->samples[0], rawSize) ||
+            (ViBe_LZ::Adler32(&model->samples[0], rawSize) != read32(snapshot + 28)))
+        {
+            return VIBE_ERROR_DATA;
+        }
+        Model.ImportSamples(model->samples, numSamples);
+    }
+    catch (...)
+    {
+        return VIBE_ERROR_MEMORY;
+    }
+    model->trained = true;
+    return VIBE_OK;
+}
+
+int vibe_get_stats(vibe_model* model, vibe_stats* stats)
+{
+    if ((model == NULL) || (stats == NULL))
+    {
+        return VIBE_ERROR_ARGUMENT;
+    }
+    ViBe_Model& Model = model->model;
+    stats->width = Model.getWidth();
+    stats->height = Model.getHeight();
+    stats->frames = Model.getFrameCount();
+    stats->foreground_pixels = Model.getForegroundCount();
+    stats->illumination_changes = Model.getIlluminationChanges();
+    stats->jitter_x = Model.getJitterX();
+    stats->jitter_y = Model.getJitterY();
+    stats->dirty_pixels = Model.isDirtyTrackingEnabled() ? Model.getNumDirty() : 0;
+    return VIBE_OK;
+}
@@ -0,0 +1,107 @@
+#ifndef __VIBE_C_H__
+#define __VIBE_C_H__
+
+/*
+ * C interface to the ViBe background model, built as a shared library (the SharedLib target) so that services in
+ * other languages (i.e. Python through ctypes, Go through cgo) can segment frames in process.
+ *
+ * The interface only uses C types, the model is an opaque handle. Frames are passed as raw buffers of packed RGB
+ * (3 bytes per pixel), masks are returned as 1 byte per pixel (0 background, 255 foreground). Strides are in bytes.
+ * Functions that can fail return VIBE_OK or one of the negative VIBE_ERROR codes, a handle may only be used by one
+ * thread at a time.
+ *
+ * Typical use:
+ *   vibe_model* model = vibe_create(width, height);
+ *   vibe_set_param(model, VIBE_PARAM_DISTANCE_MODE, VIBE_DISTANCE_CHROMA);
+ *   vibe_train(model, trainingFrames, numTrainingFrames, width*3);
+ *   for each frame: vibe_segment(model, frame, width*3, mask, width);
+ *   vibe_destroy(model);
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#  if defined(VIBE_BUILD_SHARED)
+#    define VIBE_API __declspec(dllexport)
+#  else
+#    define VIBE_API __declspec(dllimport)
+#  endif
+#else
+#  define VIBE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vibe_model vibe_model;
+
+#define VIBE_OK 0
+#define VIBE_ERROR_ARGUMENT -1      /* NULL handle or buffer, or a value out of range */
+#define VIBE_ERROR_STATE -2         /* i.e. segmenting before the model has been trained */
+#define VIBE_ERROR_DATA -3          /* a snapshot that is corrupt or from a model of another size */
+#define VIBE_ERROR_MEMORY -4
+
+/* parameters for vibe_set_param */
+#define VIBE_PARAM_SUBSAMPLING 1            /* update rate, a sample is replaced about 1 in value frames */
+#define VIBE_PARAM_UPDATE_INTERVAL 2        /* only update the model every value frames */
+#define VIBE_PARAM_DISTANCE_MODE 3          /* VIBE_DISTANCE_RGB or VIBE_DISTANCE_CHROMA */
+#define VIBE_PARAM_ILLUMINATION_MODE 4      /* VIBE_ILLUMINATION_OFF, _FAST_UPDATE or _RESEED */
+#define VIBE_PARAM_ILLUMINATION_THRESHOLD 5 /* foreground fraction (0-1) that may indicate a lighting change */
+#define VIBE_PARAM_JITTER_MAX_SHIFT 6       /* largest camera shake to compensate for in pixels, 0 disables */
+#define VIBE_PARAM_DIRTY_TRACKING 7         /* non zero to track which pixels the update step changes */
+#define VIBE_PARAM_SORTED_MATCHING 8        /* non zero to only compare samples close in intensity (rgb distance) */
+#define VIBE_PARAM_PACKED_MATCHING 9        /* non zero to compare against pixel-major packed samples (rgb distance) */
+#define VIBE_PARAM_APPROXIMATE_SAMPLES 10   /* compare only this many samples per frame (rgb distance), 0 for all */
+#define VIBE_PARAM_CHECKERBOARD 11          /* non zero to classify half of the pixels per frame and fill in the rest */
+#define VIBE_PARAM_ENVELOPE_REJECTION 12    /* non zero to reject pixels outside the range of their samples (rgb distance) */
+
+#define VIBE_DISTANCE_RGB 0
+#define VIBE_DISTANCE_CHROMA 1
+#define VIBE_ILLUMINATION_OFF 0
+#define VIBE_ILLUMINATION_FAST_UPDATE 1
+#define VIBE_ILLUMINATION_RESEED 2
+
+typedef struct vibe_stats
+{
+    int width;
+    int height;
+    long frames;                /* frames segmented */
+    int foreground_pixels;      /* foreground pixels in the last frame */
+    int illumination_changes;   /* lighting changes detected */
+    int jitter_x;               /* camera shake found in the last frame */
+    int jitter_y;
+    int dirty_pixels;           /* pixels changed since dirty tracking was last cleared, by a snapshot */
+} vibe_stats;
+
+/* create a model for frames of width x height, returns NULL on failure */
+VIBE_API vibe_model* vibe_create(int width, int height);
+
+VIBE_API void vibe_destroy(vibe_model* model);
+
+VIBE_API int vibe_set_param(vibe_model* model, int param, double value);
+
+/* initialise the background from num_frames RGB frames (normally 20), frame n becomes sample n of every pixel */
+VIBE_API int vibe_train(vibe_model* model, const unsigned char* const* frames, int num_frames, int stride);
+
+/* segment one RGB frame into mask, returns the number of foreground pixels, or a negative error code */
+VIBE_API int vibe_segment(vibe_model* model, const unsigned char* frame, int stride, unsigned char* mask,
+                          int mask_stride);
+
+/*
+ * Write a compressed snapshot of the model's samples to buffer. Returns the size of the snapshot, which is only
+ * written if it fits in capacity (call with a NULL buffer to find the size), or a negative error code.
+ * Dirty tracking is cleared when a snapshot is written.
+ */
+VIBE_API long vibe_snapshot(vibe_model* model, unsigned char* buffer, size_t capacity);
+
+/* replace the model's samples with those of a snapshot, the model counts as trained afterwards */
+VIBE_API int vibe_restore(vibe_model* model, const unsigned char* snapshot, size_t size);
+
+VIBE_API int vibe_get_stats(vibe_model* model, vibe_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
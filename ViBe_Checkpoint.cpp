@@ -0,0 +1,543 @@
+#include "ViBe_Checkpoint.h"
+
+#include <vul/vul_file_iterator.h>
+
+#ifndef _VUL_FILE_
+#define _VUL_FILE_
+#include <vul/vul_file.h>
+#endif
+
+#ifndef _STDIO_
+#define _STDIO_
+#include <stdio.h>
+#endif
+
+#ifndef _STRING_
+#define _STRING_
+#include <string.h>
+#endif
+
+#ifndef _STDLIB_
+#define _STDLIB_
+#include <stdlib.h>
+#endif
+
+#define CHECKPOINT_MAGIC 0x4B434256     // "VBCK"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_FULL 0
+#define CHECKPOINT_DELTA 1
+#define HEADER_WORDS 11
+#define CHECKPOINT_PATH_MAX 1024        // file names are formatted into buffers of this size
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+
+static unsigned long read32(const unsigned char* p)
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void write32(unsigned char* p, unsigned long value)
+{
+    p[0] = (unsigned char)(value);
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+/// write the part of a length that didn't fit in its nibble, as a run of 255's and a remainder
+static void writeLength(vcl_vector<unsigned char>& out, unsigned long length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((unsigned char)length);
+}
+
+static bool readLength(const unsigned char*& ip, const unsigned char* end, unsigned long& length)
+{
+    unsigned char byte;
+    do
+    {
+        if (ip >= end)
+        {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static void writeSequence(vcl_vector<unsigned char>& out, const unsigned char* literals, unsigned long numLiterals,
+                          unsigned long offset, unsigned long matchLength)
+{
+    unsigned long literalCode = (numLiterals < 15) ? numLiterals : 15;
+    unsigned long matchCode = 0;
+    if (matchLength > 0)
+    {
+        matchCode = ((matchLength - LZ_MIN_MATCH) < 15) ? (matchLength - LZ_MIN_MATCH) : 15;
+    }
+    out.push_back((unsigned char)((literalCode << 4) | matchCode));
+    if (literalCode == 15)
+    {
+        writeLength(out, numLiterals - 15);
+    }
+    out.insert(out.end(), literals, literals + numLiterals);
+    if (matchLength > 0)
+    {
+        out.push_back((unsigned char)(offset));
+        out.push_back((unsigned char)(offset >> 8));
+        if (matchCode == 15)
+        {
+            writeLength(out, matchLength - LZ_MIN_MATCH - 15);
+        }
+    }
+}
+
+void ViBe_LZ::Compress(const unsigned char* src, unsigned long size, vcl_vector<unsigned char>& out)
+{
+    vcl_vector<long> table;
+    ViBe_LZ::Compress(src, size, out, table);
+}
+
+void ViBe_LZ::Compress(const unsigned char* src, unsigned long size, vcl_vector<unsigned char>& out,
+                       vcl_vector<long>& table)
+{
+    out.clear();
+    /// most recent position of each hashed 4 byte sequence, only allocated the first time
+    table.assign(1 << LZ_HASH_BITS, -1);
+    unsigned long anchor = 0;
+    unsigned long pos = 0;
+    while (pos + LZ_MIN_MATCH <= size)
+    {
+        unsigned long sequence = read32(src + pos);
+        unsigned long hash = ((sequence * 2654435761UL) & 0xFFFFFFFFUL) >> (32 - LZ_HASH_BITS);
+        long ref = table[hash];
+        table[hash] = pos;
+        if ((ref >= 0) && (pos - ref <= LZ_MAX_OFFSET) && (read32(src + ref) == sequence))
+        {
+            unsigned long length = LZ_MIN_MATCH;
+            while ((pos + length < size) && (src[ref + length] == src[pos + length]))
+            {
+                length++;
+            }
+            writeSequence(out, src + anchor, pos - anchor, pos - ref, length);
+            pos += length;
+            anchor = pos;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+    /// the last sequence is literals only, the decoder knows it's the last as the input ends after it
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+bool ViBe_LZ::Decompress(const unsigned char* src, unsigned long srcSize, unsigned char* dst, unsigned long size)
+{
+    const unsigned char* ip = src;
+    const unsigned char* end = src + srcSize;
+    unsigned long op = 0;
+    while (ip < end)
+    {
+        unsigned char token = *ip++;
+        unsigned long numLiterals = token >> 4;
+        if ((numLiterals == 15) && !readLength(ip, end, numLiterals))
+        {
+            return false;
+        }
+        if ((numLiterals > (unsigned long)(end - ip)) || (op + numLiterals > size))
+        {
+            return false;
+        }
+        memcpy(dst + op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == end)
+        {
+            break;
+        }
+
+        if (end - ip < 2)
+        {
+            return false;
+        }
+        unsigned long offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        unsigned long length = token & 15;
+        if ((length == 15) && !readLength(ip, end, length))
+        {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if ((offset == 0) || (offset > op) || (op + length > size))
+        {
+            return false;
+        }
+        /// the match may overlap the output it is copying, so copy byte by byte
+        for (unsigned long k = 0; k < length; k++, op++)
+        {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return op == size;
+}
+
+unsigned long ViBe_LZ::Adler32(const unsigned char* data, unsigned long size)
+{
+    unsigned long a = 1;
+    unsigned long b = 0;
+    while (size > 0)
+    {
+        /// 5552 is the most bytes that can be summed before b can overflow 32 bits
+        unsigned long block = (size < 5552) ? size : 5552;
+        size -= block;
+        while (block-- > 0)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/// sequence number from a checkpoint_<sequence>.vbc file name, -1 if it isn't one
+static int parseSequence(const vcl_string& path)
+{
+    vcl_string name = vul_file::strip_directory(path);
+    if ((name.compare(0, 11, "checkpoint_") != 0) || (name.size() < 16) || (name.compare(name.size() - 4, 4, ".vbc") != 0))
+    {
+        return -1;
+    }
+    return atoi(name.c_str() + 11);
+}
+
+/// format the path of a checkpoint into name (of CHECKPOINT_PATH_MAX bytes), returns false if it doesn't fit
+static bool checkpointName(char* name, const vcl_string& directory, int sequence)
+{
+    /// "/checkpoint_", up to 10 digits, ".vbc.tmp" and the terminator
+    if (directory.size() + 32 > CHECKPOINT_PATH_MAX)
+    {
+        return false;
+    }
+    sprintf(name, "%s/checkpoint_%08d.vbc", directory.c_str(), sequence);
+    return true;
+}
+
+ViBe_CheckpointWriter::ViBe_CheckpointWriter()
+{
+    fullEvery = 1;
+    sequence = 0;
+    lastFull = -1;
+    previousFull = -1;
+    firstWritten = 0;
+    deltaClear = false;
+}
+
+void ViBe_CheckpointWriter::Open(const vcl_string& Directory, int FullEvery)
+{
+    directory = Directory;
+    fullEvery = (FullEvery > 0) ? FullEvery : 1;
+    lastFull = -1;
+    previousFull = -1;
+    state.clear();
+
+    /// carry on after any chain already in the directory, so a standby that is tailing it sees the new files
+    sequence = 0;
+    for (vul_file_iterator fn=(directory + "/checkpoint_*.vbc"); fn; ++fn)
+    {
+        int existing = parseSequence(fn());
+        if (existing >= sequence)
+        {
+            sequence = existing + 1;
+        }
+    }
+    firstWritten = sequence;
+}
+
+bool ViBe_CheckpointWriter::Write(ViBe_Model& model, int frame)
+{
+    unsigned long size = model.getWidth()*model.getHeight()*NUM_SAMPLES*3;
+    bool full = (lastFull < 0) || (sequence - lastFull >= fullEvery) || (state.size() != size);
+    bool ok;
+    /// room for the first delta, every pixel to be dirty and incompressible data, so later checkpoints never grow them
+    delta.reserve(size);
+    dirtyPixels.reserve(model.getWidth()*model.getHeight());
+    compressed.reserve(size + size/255 + 16);
+    if (full)
+    {
+        model.ExportSamples(state);
+        model.ClearDirty();
+        ok = this->WriteFile(CHECKPOINT_FULL, frame, model, state, ViBe_LZ::Adler32(&state[0], size));
+    }
+    else if (model.isDirtyTrackingEnabled())
+    {
+        /// only the dirty pixels can differ from the last checkpoint, everywhere else the delta stays zero
+        if (!deltaClear || (delta.size() != size))
+        {
+            delta.assign(size, 0);
+        }
+        dirtyPixels.clear();
+        model.CollectDirty(dirtyPixels, true);
+        const int pixelSize = NUM_SAMPLES*3;
+        for (unsigned k = 0; k < dirtyPixels.size(); k++)
+        {
+            unsigned char* pixelDelta = &delta[dirtyPixels[k]*pixelSize];
+            unsigned char* pixelState = &state[dirtyPixels[k]*pixelSize];
+            model.ExportPixelSamples(dirtyPixels[k], pixelDelta);
+            for (int b = 0; b < pixelSize; b++)
+            {
+                pixelDelta[b] ^= pixelState[b];
+                pixelState[b] ^= pixelDelta[b];
+            }
+        }
+        ok = this->WriteFile(CHECKPOINT_DELTA, frame, model, delta, ViBe_LZ::Adler32(&state[0], size));
+        for (unsigned k = 0; k < dirtyPixels.size(); k++)
+        {
+            unsigned char* pixelDelta = &delta[dirtyPixels[k]*pixelSize];
+            for (int b = 0; b < pixelSize; b++)
+            {
+                pixelDelta[b] = 0;
+            }
+        }
+        deltaClear = true;
+    }
+    else
+    {
+        /// export into delta, then turn it into the delta while bringing state up to date
+        model.ExportSamples(delta);
+        for (unsigned long k = 0; k < size; k++)
+        {
+            delta[k] ^= state[k];
+            state[k] ^= delta[k];
+        }
+        deltaClear = false;
+        ok = this->WriteFile(CHECKPOINT_DELTA, frame, model, delta, ViBe_LZ::Adler32(&state[0], size));
+    }
+    if (!ok)
+    {
+        /// make sure the next checkpoint doesn't depend on the one that failed
+        lastFull = -1;
+        return false;
+    }
+
+    if (full)
+    {
+        previousFull = lastFull;
+        lastFull = sequence;
+        if (previousFull >= 0)
+        {
+            this->RemoveOlderThan(previousFull);
+        }
+    }
+    sequence++;
+    return true;
+}
+
+bool ViBe_CheckpointWriter::WriteFile(int type, int frame, ViBe_Model& model, vcl_vector<unsigned char>& raw,
+                                      unsigned long checksum)
+{
+    ViBe_LZ::Compress(&raw[0], raw.size(), compressed, hashTable);
+
+    unsigned char header[HEADER_WORDS*4];
+    unsigned long words[HEADER_WORDS] = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION, (unsigned long)type,
+                                          (unsigned long)sequence, (unsigned long)frame,
+                                          (unsigned long)model.getWidth(), (unsigned long)model.getHeight(),
+                                          (unsigned long)model.getNumSamples(), (unsigned long)raw.size(),
+                                          (unsigned long)compressed.size(), checksum };
+    for (int k = 0; k < HEADER_WORDS; k++)
+    {
+        write32(header + 4*k, words[k]);
+    }
+
+    char filename[CHECKPOINT_PATH_MAX];
+    char temporary[CHECKPOINT_PATH_MAX + 4];
+    if (!checkpointName(filename, directory, sequence))
+    {
+        return false;
+    }
+    sprintf(temporary, "%s.tmp", filename);
+    FILE* file = fopen(temporary, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool ok = (fwrite(header, 1, sizeof(header), file) == sizeof(header)) &&
+              (fwrite(&compressed[0], 1, compressed.size(), file) == compressed.size());
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        remove(temporary);
+        return false;
+    }
+    remove(filename);
+    return rename(temporary, filename) == 0;
+}
+
+void ViBe_CheckpointWriter::RemoveOlderThan(int oldest)
+{
+    char filename[CHECKPOINT_PATH_MAX];
+    for (; firstWritten < oldest; firstWritten++)
+    {
+        if (checkpointName(filename, directory, firstWritten))
+        {
+            remove(filename);
+        }
+    }
+}
+
+ViBe_CheckpointReader::ViBe_CheckpointReader()
+{
+    sequence = -1;
+    frame = -1;
+}
+
+void ViBe_CheckpointReader::Open(const vcl_string& Directory)
+{
+    directory = Directory;
+    sequence = -1;
+    frame = -1;
+}
+
+int ViBe_CheckpointReader::getFrame()
+{
+    return frame;
+}
+
+int ViBe_CheckpointReader::FindLatestFull()
+{
+    int latest = -1;
+    for (vul_file_iterator fn=(directory + "/checkpoint_*.vbc"); fn; ++fn)
+    {
+        int candidate = parseSequence(fn());
+        if (candidate <= latest)
+        {
+            continue;
+        }
+        FILE* file = fopen(fn(), "rb");
+        if (file == NULL)
+        {
+            continue;
+        }
+        unsigned char header[12];
+        if ((fread(header, 1, sizeof(header), file) == sizeof(header)) && (read32(header) == CHECKPOINT_MAGIC) &&
+            (read32(header + 8) == CHECKPOINT_FULL))
+        {
+            latest = candidate;
+        }
+        fclose(file);
+    }
+    return latest;
+}
+
+/// returns 1 if the checkpoint was applied, 0 if it doesn't exist (yet), -1 if it is corrupt or doesn't fit the model
+int ViBe_CheckpointReader::ReadFile(int number, ViBe_Model& model)
+{
+    char filename[CHECKPOINT_PATH_MAX];
+    FILE* file = checkpointName(filename, directory, number) ? fopen(filename, "rb") : NULL;
+    if (file == NULL)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < HEADER_WORDS*4)
+    {
+        fclose(file);
+        return -1;
+    }
+    fileData.resize(size);
+    bool ok = fread(&fileData[0], 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok)
+    {
+        return -1;
+    }
+
+    unsigned long words[HEADER_WORDS];
+    for (int k = 0; k < HEADER_WORDS; k++)
+    {
+        words[k] = read32(&fileData[4*k]);
+    }
+    unsigned long type = words[2];
+    unsigned long rawSize = words[8];
+    if ((words[0] != CHECKPOINT_MAGIC) || (words[1] != CHECKPOINT_VERSION) ||
+        (words[5] != (unsigned long)model.getWidth()) || (words[6] != (unsigned long)model.getHeight()) ||
+        (words[9] != (unsigned long)(size - HEADER_WORDS*4)))
+    {
+        return -1;
+    }
+    if ((type == CHECKPOINT_DELTA) && (state.size() != rawSize))
+    {
+        return -1;
+    }
+
+    raw.resize(rawSize);
+    if (!ViBe_LZ::Decompress(&fileData[HEADER_WORDS*4], words[9], &raw[0], rawSize))
+    {
+        return -1;
+    }
+    if (type == CHECKPOINT_FULL)
+    {
+        state.swap(raw);
+    }
+    else
+    {
+        for (unsigned long k = 0; k < rawSize; k++)
+        {
+            state[k] ^= raw[k];
+        }
+    }
+
+    if ((ViBe_LZ::Adler32(&state[0], state.size()) != words[10]) || !model.ImportSamples(state, words[7]))
+    {
+        state.clear();
+        return -1;
+    }
+    frame = words[4];
+    return 1;
+}
+
+int ViBe_CheckpointReader::Poll(ViBe_Model& model)
+{
+    int applied = 0;
+    while (true)
+    {
+        int next = sequence;
+        if (next < 0)
+        {
+            next = this->FindLatestFull();
+            if (next < 0)
+            {
+                return applied;
+            }
+        }
+
+        int result = this->ReadFile(next, model);
+        if (result < 0)
+        {
+            sequence = -1;
+            return -1;
+        }
+        if (result == 0)
+        {
+            /// not written yet, unless the writer has moved on past it and removed it, then resync on a newer full
+            if ((sequence >= 0) && (this->FindLatestFull() > sequence))
+            {
+                sequence = -1;
+                continue;
+            }
+            return applied;
+        }
+        sequence = next + 1;
+        applied++;
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef __VIBE_CHECKPOINT_H__
+#define __VIBE_CHECKPOINT_H__
+
+#include "ViBe_Model.h"
+
+#ifndef _VCL_STRING_
+#define _VCL_STRING_
+#include <vcl_string.h>
+#endif
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+/*
+ * Model checkpoints, used to move a camera's model to another host without a learning gap.
+ *
+ * A checkpoint directory holds a chain of files named checkpoint_<sequence>.vbc. Each file is either a full checkpoint
+ * (the exported samples of the model) or a delta checkpoint (the exported samples XOR'ed with the previous checkpoint
+ * in the chain). Only a small fraction of the samples change between checkpoints, so deltas are mostly zeros and
+ * compress to very little with the LZ compressor below. If the model tracks dirty pixels, a delta is built from just the
+ * pixels that changed instead of exporting the whole model. Files are written under a temporary name and renamed when
+ * complete, so a standby process tailing the directory never sees a partial checkpoint.
+ *
+ * Every file starts with a header of little endian 32 bit words:
+ *   magic, version, type (0 full, 1 delta), sequence, frame, width, height, samples per pixel,
+ *   raw size, compressed size, adler32 of the model after the checkpoint is applied
+ */
+
+/*
+ * LZ77 compressor in the style of LZ4: sequences of a token byte (literal count in the high nibble, match length - 4
+ * in the low nibble, 15 meaning more length bytes follow), the literals, and a 16 bit match offset.
+ */
+class ViBe_LZ
+{
+public:
+    static void Compress(const unsigned char* src, unsigned long size, vcl_vector<unsigned char>& out);
+    /* as above, with a hash table kept by the caller so repeated calls make no allocations (once out is large enough) */
+    static void Compress(const unsigned char* src, unsigned long size, vcl_vector<unsigned char>& out,
+                         vcl_vector<long>& table);
+    /* returns false if the data is corrupt or doesn't decompress to exactly size bytes */
+    static bool Decompress(const unsigned char* src, unsigned long srcSize, unsigned char* dst, unsigned long size);
+    static unsigned long Adler32(const unsigned char* data, unsigned long size);
+};
+
+/*
+ * Writes a checkpoint chain for a model
+ */
+class ViBe_CheckpointWriter
+{
+public:
+    ViBe_CheckpointWriter();
+
+    /*
+     * directory -  where to write the checkpoints, must exist
+     * fullEvery -  write a full checkpoint every fullEvery checkpoints, the rest are deltas. When a full checkpoint is
+     *              written, files older than the previous full checkpoint are removed
+     */
+    void Open(const vcl_string& directory, int fullEvery);
+
+    /*
+     * Write the next checkpoint of the chain, frame is recorded in the header for information. Makes no heap
+     * allocations after the first checkpoint, so it can be called from the steady state frame loop
+     */
+    bool Write(ViBe_Model& model, int frame);
+
+private:
+    bool WriteFile(int type, int frame, ViBe_Model& model, vcl_vector<unsigned char>& raw, unsigned long checksum);
+    void RemoveOlderThan(int oldest);
+
+    vcl_string directory;
+    int fullEvery;
+    int sequence;               // sequence number of the next checkpoint
+    int lastFull;               // sequence of the most recent full checkpoint, -1 if none
+    int previousFull;           // sequence of the full checkpoint before that, -1 if none
+    int firstWritten;           // oldest sequence this writer has not yet removed
+    vcl_vector<unsigned char> state;        // samples as of the last checkpoint
+    vcl_vector<unsigned char> delta;
+    bool deltaClear;                        // whether delta is all zeros, as dirty pixel deltas expect
+    vcl_vector<int> dirtyPixels;
+    vcl_vector<unsigned char> compressed;
+    vcl_vector<long> hashTable;             // for ViBe_LZ::Compress
+};
+
+/*
+ * Follows a checkpoint chain, i.e. in a standby process, applying each new checkpoint to a model as it appears
+ */
+class ViBe_CheckpointReader
+{
+public:
+    ViBe_CheckpointReader();
+
+    void Open(const vcl_string& directory);
+
+    /*
+     * Apply every checkpoint written since the last poll. The first poll starts from the newest full checkpoint in the
+     * directory. Returns the number of checkpoints applied, or -1 if the chain is broken (in which case the next
+     * poll starts again from the newest full checkpoint)
+     */
+    int Poll(ViBe_Model& model);
+
+    int getFrame();             // frame number of the last checkpoint applied
+
+private:
+    int ReadFile(int number, ViBe_Model& model);
+    int FindLatestFull();
+
+    vcl_string directory;
+    int sequence;               // sequence number of the next checkpoint to apply, -1 before the first poll
+    int frame;
+    vcl_vector<unsigned char> state;
+    vcl_vector<unsigned char> fileData;
+    vcl_vector<unsigned char> raw;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "ViBe_Follow.h"
+
+#ifndef _STRING_
+#define _STRING_
+#include <string.h>
+#endif
+
+#ifndef _VCL_IOSTREAM_
+#define _VCL_IOSTREAM_
+#include <vcl_iostream.h>
+#endif
+
+#ifndef _LIMITS_
+#define _LIMITS_
+#include <limits.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+ViBe_DirectoryWatcher::ViBe_DirectoryWatcher()
+{
+    fd = -1;
+    watch = -1;
+    maxBacklog = FOLLOW_BACKLOG;
+    reorderWindow = FOLLOW_REORDER;
+    lastFrame = -1;
+    dropped = 0;
+    late = 0;
+}
+
+ViBe_DirectoryWatcher::~ViBe_DirectoryWatcher()
+{
+    Close();
+}
+
+bool ViBe_DirectoryWatcher::Open(const vcl_string& Directory, const vcl_string& Extension, int MaxBacklog,
+                                 int ReorderWindow)
+{
+    Close();
+    directory = Directory;
+    extension = Extension;
+    maxBacklog = (MaxBacklog > 0) ? MaxBacklog : 1;
+    reorderWindow = (ReorderWindow >= 0) ? ReorderWindow : 0;
+    lastFrame = -1;
+    pending.clear();
+    dropped = 0;
+    late = 0;
+
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    /// a frame is only complete once its writer has closed it, or when it is renamed into the directory
+    watch = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (watch < 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+#else
+    vcl_cerr << "Following a directory needs inotify, which is only available on Linux" << vcl_endl;
+    return false;
+#endif
+}
+
+void ViBe_DirectoryWatcher::Close()
+{
+#ifdef __linux__
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+#endif
+    fd = -1;
+    watch = -1;
+}
+
+void ViBe_DirectoryWatcher::SetLastFrame(long frameNumber)
+{
+    lastFrame = frameNumber;
+    while (!pending.empty() && (pending.begin()->first <= lastFrame))
+    {
+        pending.erase(pending.begin());
+    }
+}
+
+int ViBe_DirectoryWatcher::getDropped()
+{
+    return dropped;
+}
+
+int ViBe_DirectoryWatcher::getLate()
+{
+    return late;
+}
+
+long ViBe_DirectoryWatcher::FrameNumber(const vcl_string& filename)
+{
+    vcl_string::size_type nameStart = filename.find_last_of("/\\");
+    nameStart = (nameStart == vcl_string::npos) ? 0 : nameStart + 1;
+
+    vcl_string::size_type end = filename.size();
+    while ((end > nameStart) && ((filename[end - 1] < '0') || (filename[end - 1] > '9')))
+    {
+        end--;
+    }
+    if (end == nameStart)
+    {
+        return -1;
+    }
+    vcl_string::size_type start = end;
+    while ((start > nameStart) && (filename[start - 1] >= '0') && (filename[start - 1] <= '9'))
+    {
+        start--;
+    }
+    long number = 0;
+    for (vcl_string::size_type c = start; c < end; c++)
+    {
+        int digit = filename[c] - '0';
+        if (number > (LONG_MAX - digit) / 10)
+        {
+            return LONG_MAX;
+        }
+        number = number*10 + digit;
+    }
+    return number;
+}
+
+void ViBe_DirectoryWatcher::AddFile(const char* name)
+{
+    size_t length = strlen(name);
+    if ((length < extension.size()) || (extension.compare(0, extension.size(), name + length - extension.size()) != 0))
+    {
+        return;
+    }
+    long frameNumber = FrameNumber(name);
+    if (frameNumber < 0)
+    {
+        return;
+    }
+    if (frameNumber <= lastFrame)
+    {
+        late++;
+        return;
+    }
+    pending[frameNumber] = directory + "/" + name;
+
+    /// when segmentation falls behind, the oldest frames are the least useful to a live consumer
+    while ((int)pending.size() > maxBacklog)
+    {
+        pending.erase(pending.begin());
+        dropped++;
+    }
+}
+
+bool ViBe_DirectoryWatcher::ReadEvents()
+{
+#ifdef __linux__
+    for (;;)
+    {
+        ssize_t size = read(fd, eventBuffer, sizeof(eventBuffer));
+        if (size < 0)
+        {
+            return (errno == EAGAIN) || (errno == EINTR);
+        }
+        ssize_t offset = 0;
+        while (offset + (ssize_t)sizeof(struct inotify_event) <= size)
+        {
+            /// the events in the buffer are not necessarily aligned
+            struct inotify_event event;
+            memcpy(&event, eventBuffer + offset, sizeof(event));
+            if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                return false;
+            }
+            if (event.mask & IN_Q_OVERFLOW)
+            {
+                vcl_cerr << "inotify queue overflowed, frames have been missed" << vcl_endl;
+            }
+            if ((event.len > 0) && !(event.mask & IN_ISDIR))
+            {
+                AddFile(eventBuffer + offset + sizeof(struct inotify_event));
+            }
+            offset += sizeof(struct inotify_event) + event.len;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+bool ViBe_DirectoryWatcher::Next(vcl_string& filename, long& frameNumber)
+{
+#ifdef __linux__
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool timedOut = false;
+    for (;;)
+    {
+        if (!ReadEvents())
+        {
+            return false;
+        }
+        if (!pending.empty())
+        {
+            vcl_map<long, vcl_string>::iterator first = pending.begin();
+            if (timedOut || (first->first == lastFrame + 1) || ((int)pending.size() > reorderWindow))
+            {
+                filename = first->second;
+                frameNumber = first->first;
+                lastFrame = first->first;
+                pending.erase(first);
+                return true;
+            }
+        }
+
+        struct pollfd waitFor;
+        waitFor.fd = fd;
+        waitFor.events = POLLIN;
+        waitFor.revents = 0;
+        int ready = poll(&waitFor, 1, pending.empty() ? -1 : FOLLOW_REORDER_TIMEOUT);
+        if ((ready < 0) && (errno != EINTR))
+        {
+            return false;
+        }
+        timedOut = (ready == 0);
+    }
+#else
+    return false;
+#endif
+}
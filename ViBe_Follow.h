@@ -0,0 +1,84 @@
+#ifndef __VIBE_FOLLOW_H__
+#define __VIBE_FOLLOW_H__
+
+#ifndef _VCL_STRING_
+#define _VCL_STRING_
+#include <vcl_string.h>
+#endif
+
+#ifndef _VCL_MAP_
+#define _VCL_MAP_
+#include <vcl_map.h>
+#endif
+
+#define FOLLOW_BACKLOG 64           // most frames waiting to be segmented, the oldest are dropped beyond this
+#define FOLLOW_REORDER 4            // frames held back to put frames that arrive out of order back in order
+#define FOLLOW_REORDER_TIMEOUT 500  // ms to wait for a missing frame before moving on without it
+
+/*
+ * Watches a directory that frames are being written into (with inotify, so Linux only) and hands out each new file
+ * with the given extension once it has been closed after writing (or moved into the directory), so a single
+ * long-running model can follow a camera that keeps dropping frames into the directory.
+ *
+ * Frames are handed out in order of their frame number, the last run of digits in the file name (files without one
+ * are ignored). A frame is held back until the frame before it has been handed out, until ReorderWindow later frames
+ * have arrived or until no frame has arrived for FOLLOW_REORDER_TIMEOUT ms, whichever comes first. Frames that arrive
+ * after a later frame has been handed out are dropped, as are the oldest waiting frames when more than MaxBacklog are
+ * waiting because segmentation can't keep up, so the delay stays bounded.
+ */
+class ViBe_DirectoryWatcher
+{
+public:
+    ViBe_DirectoryWatcher();
+    ~ViBe_DirectoryWatcher();
+
+    /*
+     * Start watching, files that are complete before this are not reported
+     * returns false if the directory can't be watched (or inotify is not available)
+     */
+    bool Open(const vcl_string& directory, const vcl_string& extension, int MaxBacklog = FOLLOW_BACKLOG,
+              int ReorderWindow = FOLLOW_REORDER);
+
+    /*
+     * Block until the next frame is ready, returns false if the directory can no longer be watched
+     */
+    bool Next(vcl_string& filename, long& frameNumber);
+
+    /*
+     * Treat every frame up to frameNumber as already handed out, i.e. the frames that were in the directory already
+     */
+    void SetLastFrame(long frameNumber);
+
+    void Close();
+
+    int getDropped();       // frames dropped because the backlog was full
+    int getLate();          // frames dropped because they arrived after a later frame had been handed out
+
+    /*
+     * The last run of digits in the name of a file (not its directory), -1 if there is none. Numbers too large for a
+     * long come back as LONG_MAX
+     */
+    static long FrameNumber(const vcl_string& filename);
+
+protected:
+    bool ReadEvents();
+    void AddFile(const char* name);
+
+private:
+    ViBe_DirectoryWatcher(const ViBe_DirectoryWatcher&);
+    ViBe_DirectoryWatcher& operator=(const ViBe_DirectoryWatcher&);
+
+    int fd;                                 // inotify instance, -1 when closed
+    int watch;
+    vcl_string directory;
+    vcl_string extension;
+    int maxBacklog;
+    int reorderWindow;
+    long lastFrame;                         // frame number last handed out, -1 before the first
+    vcl_map<long, vcl_string> pending;      // frames waiting to be handed out, by frame number
+    int dropped;
+    int late;
+    char eventBuffer[4096];
+};
+
+#endif
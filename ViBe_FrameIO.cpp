@@ -0,0 +1,666 @@
+#include "ViBe_FrameIO.h"
+#include "ViBe_AllocCounter.h"
+
+#ifndef _VIL_LOAD_
+#define _VIL_LOAD_
+#include <vil/vil_load.h>
+#endif
+
+#include <vil/file_formats/vil_jpeglib.h>
+
+#ifndef _STDIO_
+#define _STDIO_
+#include <stdio.h>
+#endif
+
+#ifndef _STDLIB_
+#define _STDLIB_
+#include <stdlib.h>
+#endif
+
+#include <setjmp.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#define O_BINARY 0
+#endif
+
+/// rows of pixels libjpeg decodes together (an MCU row), the field was renamed when scaling was generalised in v7
+#if JPEG_LIB_VERSION >= 70
+#define MCU_ROW_HEIGHT(cinfo) ((cinfo).max_v_samp_factor * (cinfo).min_DCT_v_scaled_size)
+#else
+#define MCU_ROW_HEIGHT(cinfo) ((cinfo).max_v_samp_factor * (cinfo).min_DCT_scaled_size)
+#endif
+
+/// libjpeg-turbo can skip rows without decoding them and decode a range of MCU columns
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && (LIBJPEG_TURBO_VERSION_NUMBER >= 1005000)
+#define JPEG_CAN_CROP 1
+#endif
+
+/// alignment of blocks handed to libjpeg, large enough for its SIMD routines
+#define ARENA_ALIGN 64
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+/*
+ * Everything libjpeg needs that persists between frames. The JPOOL_IMAGE allocations of the memory manager are
+ * redirected to a bump allocator over a single block (the arena). If an image needs more than the arena holds, the
+ * extra is malloc'ed, and when the image is released the arena is regrown to cover it, so this only happens while
+ * warming up.
+ */
+struct ViBe_JpegState
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr errorManager;
+    jmp_buf errorJump;
+    jpeg_source_mgr sourceManager;
+
+    void* arenaBlock;               // the arena as malloc'ed, kept to free it
+    char* arena;                    // first ARENA_ALIGN aligned byte of arenaBlock
+    size_t arenaSize;
+    size_t arenaUsed;
+    vcl_vector<void*> overflow;     // blocks malloc'ed this image because the arena was full
+    size_t overflowSize;
+
+    // the memory manager's own entry points, still used for the permanent pool
+    void* (*defaultAllocSmall)(j_common_ptr, int, size_t);
+    void* (*defaultAllocLarge)(j_common_ptr, int, size_t);
+    JSAMPARRAY (*defaultAllocSArray)(j_common_ptr, int, JDIMENSION, JDIMENSION);
+    JBLOCKARRAY (*defaultAllocBArray)(j_common_ptr, int, JDIMENSION, JDIMENSION);
+    void (*defaultFreePool)(j_common_ptr, int);
+};
+
+static ViBe_JpegState* getState(j_common_ptr cinfo)
+{
+    return (ViBe_JpegState*)cinfo->client_data;
+}
+
+static void* ArenaAlloc(ViBe_JpegState* state, size_t size)
+{
+    size = ALIGN_UP(size);
+    if (state->arenaUsed + size <= state->arenaSize)
+    {
+        void* memory = state->arena + state->arenaUsed;
+        state->arenaUsed += size;
+        return memory;
+    }
+    ViBe_AllocCounter::Record();
+    void* memory = malloc(size + ARENA_ALIGN);
+    state->overflow.push_back(memory);
+    state->overflowSize += size + ARENA_ALIGN;
+    return (void*)ALIGN_UP((size_t)memory);
+}
+
+static void* JpegAllocSmall(j_common_ptr cinfo, int pool_id, size_t size)
+{
+    ViBe_JpegState* state = getState(cinfo);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return state->defaultAllocSmall(cinfo, pool_id, size);
+    }
+    return ArenaAlloc(state, size);
+}
+
+static void* JpegAllocLarge(j_common_ptr cinfo, int pool_id, size_t size)
+{
+    ViBe_JpegState* state = getState(cinfo);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return state->defaultAllocLarge(cinfo, pool_id, size);
+    }
+    return ArenaAlloc(state, size);
+}
+
+static JSAMPARRAY JpegAllocSArray(j_common_ptr cinfo, int pool_id, JDIMENSION samplesperrow, JDIMENSION numrows)
+{
+    ViBe_JpegState* state = getState(cinfo);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return state->defaultAllocSArray(cinfo, pool_id, samplesperrow, numrows);
+    }
+    JSAMPARRAY rows = (JSAMPARRAY)ArenaAlloc(state, numrows * sizeof(JSAMPROW));
+    size_t rowSize = ALIGN_UP(samplesperrow * sizeof(JSAMPLE));
+    for (JDIMENSION r = 0; r < numrows; r++)
+    {
+        rows[r] = (JSAMPROW)ArenaAlloc(state, rowSize);
+    }
+    return rows;
+}
+
+static JBLOCKARRAY JpegAllocBArray(j_common_ptr cinfo, int pool_id, JDIMENSION blocksperrow, JDIMENSION numrows)
+{
+    ViBe_JpegState* state = getState(cinfo);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return state->defaultAllocBArray(cinfo, pool_id, blocksperrow, numrows);
+    }
+    JBLOCKARRAY rows = (JBLOCKARRAY)ArenaAlloc(state, numrows * sizeof(JBLOCKROW));
+    for (JDIMENSION r = 0; r < numrows; r++)
+    {
+        rows[r] = (JBLOCKROW)ArenaAlloc(state, blocksperrow * sizeof(JBLOCK));
+    }
+    return rows;
+}
+
+static void JpegFreePool(j_common_ptr cinfo, int pool_id)
+{
+    ViBe_JpegState* state = getState(cinfo);
+    if (pool_id == JPOOL_IMAGE)
+    {
+        if (state->overflow.size() > 0)
+        {
+            /// grow the arena so the next image of this size fits in it
+            for (unsigned i = 0; i < state->overflow.size(); i++)
+            {
+                free(state->overflow[i]);
+            }
+            state->overflow.clear();
+            free(state->arenaBlock);
+            state->arenaSize = ALIGN_UP(state->arenaUsed + state->overflowSize);
+            ViBe_AllocCounter::Record();
+            state->arenaBlock = malloc(state->arenaSize + ARENA_ALIGN);
+            state->arena = (char*)ALIGN_UP((size_t)state->arenaBlock);
+            if (state->arenaBlock == NULL)
+            {
+                /// every image overflows then, as before the first one
+                state->arenaSize = 0;
+            }
+            state->overflowSize = 0;
+        }
+        state->arenaUsed = 0;
+    }
+    /// virtual arrays (only used for progressive JPEGs) are still allocated by the default memory manager
+    state->defaultFreePool(cinfo, pool_id);
+}
+
+static void JpegErrorExit(j_common_ptr cinfo)
+{
+    longjmp(getState(cinfo)->errorJump, 1);
+}
+
+static void JpegInitSource(j_decompress_ptr)
+{
+}
+
+/// the whole file is in memory, so running out of data means the file is truncated, end the image cleanly
+template <class Boolean> static Boolean JpegFillInputBuffer(j_decompress_ptr cinfo)
+{
+    static const JOCTET endOfImage[2] = { 0xFF, JPEG_EOI };
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = endOfImage;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+}
+
+/// jpeglib's boolean type is renamed by some builds of vil_jpeglib.h, so let the compiler pick it up from the slot
+template <class Boolean> static void setFillInputBuffer(Boolean (*&slot)(j_decompress_ptr))
+{
+    slot = &JpegFillInputBuffer<Boolean>;
+}
+
+static void JpegSkipInputData(j_decompress_ptr cinfo, long numBytes)
+{
+    jpeg_source_mgr* src = cinfo->src;
+    if (numBytes <= 0)
+    {
+        return;
+    }
+    if ((size_t)numBytes > src->bytes_in_buffer)
+    {
+        src->fill_input_buffer(cinfo);
+        return;
+    }
+    src->next_input_byte += numBytes;
+    src->bytes_in_buffer -= numBytes;
+}
+
+static void JpegTermSource(j_decompress_ptr)
+{
+}
+
+ViBe_FrameDecoder::ViBe_FrameDecoder()
+{
+    fileSize = 0;
+    scale = 1;
+    grayscale = false;
+    cropX = 0;
+    cropY = 0;
+    cropWidth = 0;
+    cropHeight = 0;
+
+    jpeg = new ViBe_JpegState;
+    jpeg->arenaBlock = NULL;
+    jpeg->arena = NULL;
+    jpeg->arenaSize = 0;
+    jpeg->arenaUsed = 0;
+    jpeg->overflowSize = 0;
+
+    jpeg->cinfo.err = jpeg_std_error(&jpeg->errorManager);
+    jpeg->errorManager.error_exit = JpegErrorExit;
+    jpeg_create_decompress(&jpeg->cinfo);
+    jpeg->cinfo.client_data = jpeg;
+
+    jpeg_memory_mgr* mem = jpeg->cinfo.mem;
+    jpeg->defaultAllocSmall = mem->alloc_small;
+    jpeg->defaultAllocLarge = mem->alloc_large;
+    jpeg->defaultAllocSArray = mem->alloc_sarray;
+    jpeg->defaultAllocBArray = mem->alloc_barray;
+    jpeg->defaultFreePool = mem->free_pool;
+    mem->alloc_small = JpegAllocSmall;
+    mem->alloc_large = JpegAllocLarge;
+    mem->alloc_sarray = JpegAllocSArray;
+    mem->alloc_barray = JpegAllocBArray;
+    mem->free_pool = JpegFreePool;
+
+    jpeg->sourceManager.init_source = JpegInitSource;
+    setFillInputBuffer(jpeg->sourceManager.fill_input_buffer);
+    jpeg->sourceManager.skip_input_data = JpegSkipInputData;
+    jpeg->sourceManager.resync_to_restart = jpeg_resync_to_restart;
+    jpeg->sourceManager.term_source = JpegTermSource;
+    jpeg->cinfo.src = &jpeg->sourceManager;
+}
+
+ViBe_FrameDecoder::~ViBe_FrameDecoder()
+{
+    jpeg_destroy_decompress(&jpeg->cinfo);
+    for (unsigned i = 0; i < jpeg->overflow.size(); i++)
+    {
+        free(jpeg->overflow[i]);
+    }
+    free(jpeg->arenaBlock);
+    delete jpeg;
+}
+
+void ViBe_FrameDecoder::SetScale(int Denominator)
+{
+    scale = ((Denominator == 2) || (Denominator == 4) || (Denominator == 8)) ? Denominator : 1;
+}
+
+void ViBe_FrameDecoder::SetGrayscale(bool enable)
+{
+    grayscale = enable;
+}
+
+int ViBe_FrameDecoder::getScale()
+{
+    return scale;
+}
+
+bool ViBe_FrameDecoder::isGrayscale()
+{
+    return grayscale;
+}
+
+void ViBe_FrameDecoder::SetCrop(int X, int Y, int Width, int Height)
+{
+    cropX = (X > 0) ? X : 0;
+    cropY = (Y > 0) ? Y : 0;
+    cropWidth = ((Width > 0) && (Height > 0)) ? Width : 0;
+    cropHeight = ((Width > 0) && (Height > 0)) ? Height : 0;
+}
+
+/*
+ * Read the header, start decompressing and move to the first row of the crop. Returns the size of the crop in ni, nj
+ * and where it starts in each decoded row (of cinfo.output_width pixels) in columnOffset, or false if the crop is
+ * outside the frame
+ */
+bool ViBe_FrameDecoder::StartDecompress(const unsigned char* data, unsigned long size, unsigned& ni, unsigned& nj,
+                                        unsigned& columnOffset)
+{
+    jpeg_decompress_struct& cinfo = jpeg->cinfo;
+    jpeg->sourceManager.next_input_byte = data;
+    jpeg->sourceManager.bytes_in_buffer = size;
+    jpeg_read_header(&cinfo, TRUE);
+    if (grayscale || (cinfo.jpeg_color_space == JCS_GRAYSCALE))
+    {
+        cinfo.out_color_space = JCS_GRAYSCALE;
+    }
+    else
+    {
+        cinfo.out_color_space = JCS_RGB;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale;
+    jpeg_start_decompress(&cinfo);
+
+    columnOffset = 0;
+    ni = cinfo.output_width;
+    nj = cinfo.output_height;
+    if (cropWidth == 0)
+    {
+        return true;
+    }
+
+    /// the crop in output pixels, rounded outwards
+    unsigned left = cropX / scale;
+    unsigned top = cropY / scale;
+    unsigned right = (cropX + cropWidth + scale - 1) / scale;
+    unsigned bottom = (cropY + cropHeight + scale - 1) / scale;
+    right = (right < cinfo.output_width) ? right : cinfo.output_width;
+    bottom = (bottom < cinfo.output_height) ? bottom : cinfo.output_height;
+    if ((left >= right) || (top >= bottom))
+    {
+        return false;
+    }
+    ni = right - left;
+    nj = bottom - top;
+
+#ifdef JPEG_CAN_CROP
+    /// decoding starts at the MCU column holding left, and the width is widened to whole MCUs
+    JDIMENSION xOffset = left;
+    JDIMENSION width = ni;
+    jpeg_crop_scanline(&cinfo, &xOffset, &width);
+    columnOffset = left - xOffset;
+    if (top > 0)
+    {
+        jpeg_skip_scanlines(&cinfo, top);
+    }
+#else
+    columnOffset = left;
+    unsigned rowSize = cinfo.output_width * cinfo.output_components;
+    if (rowBuffer.size() < rowSize)
+    {
+        rowBuffer.resize(rowSize);
+    }
+    JSAMPROW row = &rowBuffer[0];
+    while (cinfo.output_scanline < top)
+    {
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+#endif
+    return true;
+}
+
+/// rows below a crop are never read, the image is abandoned instead
+void ViBe_FrameDecoder::FinishDecompress()
+{
+    if (jpeg->cinfo.output_scanline < jpeg->cinfo.output_height)
+    {
+        jpeg_abort_decompress(&jpeg->cinfo);
+    }
+    else
+    {
+        jpeg_finish_decompress(&jpeg->cinfo);
+    }
+}
+
+bool ViBe_FrameDecoder::isJpeg(const unsigned char* data, unsigned long size)
+{
+    return (size >= 3) && (data[0] == 0xFF) && (data[1] == 0xD8) && (data[2] == 0xFF);
+}
+
+bool ViBe_FrameDecoder::ReadFile(const char* filename)
+{
+    int file = open(filename, O_RDONLY | O_BINARY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+        close(file);
+        return false;
+    }
+    fileSize = info.st_size;
+    if (fileBuffer.size() < fileSize)
+    {
+        fileBuffer.resize(fileSize);
+    }
+    unsigned long done = 0;
+    while (done < fileSize)
+    {
+        int got = read(file, &fileBuffer[done], fileSize - done);
+        if (got <= 0)
+        {
+            break;
+        }
+        done += got;
+    }
+    close(file);
+    fileSize = done;
+    return fileSize > 0;
+}
+
+bool ViBe_FrameDecoder::DecodeFile(const char* filename)
+{
+    if (!this->ReadFile(filename))
+    {
+        return false;
+    }
+    if (!isJpeg(&fileBuffer[0], fileSize))
+    {
+        image = vil_load(filename);
+        return image.size() > 0;
+    }
+    return this->DecodeMemory(&fileBuffer[0], fileSize);
+}
+
+bool ViBe_FrameDecoder::DecodeMemory(const unsigned char* data, unsigned long size)
+{
+    if (!isJpeg(data, size))
+    {
+        return false;
+    }
+
+    jpeg_decompress_struct& cinfo = jpeg->cinfo;
+    if (setjmp(jpeg->errorJump))
+    {
+        /// libjpeg reported an error, release the image (which resets the arena) and give up on this frame
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+
+    unsigned ni; unsigned nj; unsigned columnOffset;
+    if (!this->StartDecompress(data, size, ni, nj, columnOffset))
+    {
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+    unsigned components = cinfo.output_components;
+    unsigned rowSize = cinfo.output_width * components;
+    unsigned char* topLeft = pixelBuffer.empty() ? NULL : &pixelBuffer[columnOffset * components];
+    if ((image.ni() != ni) || (image.nj() != nj) || (image.istep() != (vcl_ptrdiff_t)components) ||
+        (image.jstep() != (vcl_ptrdiff_t)rowSize) || (image.top_left_ptr() != topLeft) ||
+        (pixelBuffer.size() < nj*rowSize))
+    {
+        if (pixelBuffer.size() < nj*rowSize)
+        {
+            pixelBuffer.resize(nj*rowSize);
+        }
+        /// a grayscale frame is presented as 3 planes that all alias the single decoded plane
+        vcl_ptrdiff_t planestep = (components == 1) ? 0 : 1;
+        image = vil_image_view<unsigned char>(&pixelBuffer[columnOffset * components], ni, nj, 3, components, rowSize,
+                                              planestep);
+    }
+
+    unsigned firstRow = cinfo.output_scanline;
+    JSAMPROW rows[16];
+    while (cinfo.output_scanline < firstRow + nj)
+    {
+        unsigned done = cinfo.output_scanline - firstRow;
+        unsigned count = cinfo.rec_outbuf_height;
+        if (count > 16)
+        {
+            count = 16;
+        }
+        if (count > nj - done)
+        {
+            count = nj - done;
+        }
+        for (unsigned r = 0; r < count; r++)
+        {
+            rows[r] = &pixelBuffer[(done + r) * rowSize];
+        }
+        jpeg_read_scanlines(&cinfo, rows, count);
+    }
+    this->FinishDecompress();
+    return true;
+}
+
+vil_image_view<unsigned char>& ViBe_FrameDecoder::getImage()
+{
+    return image;
+}
+
+bool ViBe_FrameDecoder::SegmentFile(const char* filename, ViBe_Model& model, ViBe_MaskRowConsumer& consumer)
+{
+    if (!this->ReadFile(filename))
+    {
+        return false;
+    }
+    if (!isJpeg(&fileBuffer[0], fileSize))
+    {
+        image = vil_load(filename);
+        if (image.size() == 0)
+        {
+            return false;
+        }
+        return this->SegmentImage(model, consumer);
+    }
+    return this->SegmentMemory(&fileBuffer[0], fileSize, model, consumer);
+}
+
+bool ViBe_FrameDecoder::SegmentImage(ViBe_Model& model, ViBe_MaskRowConsumer& consumer)
+{
+    unsigned ni = image.ni();
+    unsigned nj = image.nj();
+    if (((int)ni != model.getWidth()) || ((int)nj != model.getHeight()))
+    {
+        return false;
+    }
+    if (maskBuffer.size() < ni*nj)
+    {
+        maskBuffer.resize(ni*nj);
+    }
+    vil_image_view<unsigned char> mask(&maskBuffer[0], ni, nj, 1, 1, ni, ni*nj);
+    model.Segment(image, mask);
+    for (unsigned j = 0; j < nj; j += 16)
+    {
+        unsigned count = (nj - j < 16) ? nj - j : 16;
+        vil_image_view<unsigned char> maskRows(&maskBuffer[j*ni], ni, count, 1, 1, ni, ni*count);
+        consumer.MaskRows(maskRows, j);
+    }
+    return true;
+}
+
+bool ViBe_FrameDecoder::SegmentMemory(const unsigned char* data, unsigned long size, ViBe_Model& model,
+                                      ViBe_MaskRowConsumer& consumer)
+{
+    if (!model.canSegmentBands())
+    {
+        if (!this->DecodeMemory(data, size))
+        {
+            return false;
+        }
+        return this->SegmentImage(model, consumer);
+    }
+    if (!isJpeg(data, size))
+    {
+        return false;
+    }
+
+    jpeg_decompress_struct& cinfo = jpeg->cinfo;
+    /// volatile, it is read after longjmp returns to the setjmp below
+    volatile bool started = false;
+    if (setjmp(jpeg->errorJump))
+    {
+        /// the rows segmented so far have updated the model, finish the frame's bookkeeping before giving up on it
+        jpeg_abort_decompress(&cinfo);
+        if (started)
+        {
+            model.EndRows();
+        }
+        return false;
+    }
+
+    unsigned ni; unsigned nj; unsigned columnOffset;
+    if (!this->StartDecompress(data, size, ni, nj, columnOffset))
+    {
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+    unsigned components = cinfo.output_components;
+    unsigned rowSize = cinfo.output_width * components;
+    if (((int)ni != model.getWidth()) || ((int)nj != model.getHeight()))
+    {
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+    /// rows of one MCU row, which libjpeg decodes together
+    unsigned groupHeight = MCU_ROW_HEIGHT(cinfo);
+    if (rowBuffer.size() < groupHeight*rowSize)
+    {
+        rowBuffer.resize(groupHeight*rowSize);
+    }
+    if (maskBuffer.size() < groupHeight*ni)
+    {
+        maskBuffer.resize(groupHeight*ni);
+    }
+    vcl_ptrdiff_t planestep = (components == 1) ? 0 : 1;
+    unsigned top = cinfo.output_scanline;
+
+    model.BeginRows();
+    started = true;
+    JSAMPROW rows[16];
+    while (cinfo.output_scanline < top + nj)
+    {
+        unsigned firstRow = cinfo.output_scanline - top;
+        unsigned count = (nj - firstRow < groupHeight) ? nj - firstRow : groupHeight;
+        while (cinfo.output_scanline - top < firstRow + count)
+        {
+            unsigned done = cinfo.output_scanline - top - firstRow;
+            unsigned chunk = (count - done < 16) ? count - done : 16;
+            for (unsigned r = 0; r < chunk; r++)
+            {
+                rows[r] = &rowBuffer[(done + r) * rowSize];
+            }
+            jpeg_read_scanlines(&cinfo, rows, chunk);
+        }
+
+        vil_image_view<unsigned char> rowImage(&rowBuffer[columnOffset * components], ni, count, 3, components,
+                                               rowSize, planestep);
+        vil_image_view<unsigned char> maskRows(&maskBuffer[0], ni, count, 1, 1, ni, ni*count);
+        model.SegmentRows(rowImage, maskRows, firstRow);
+        consumer.MaskRows(maskRows, firstRow);
+    }
+    model.EndRows();
+    started = false;
+    this->FinishDecompress();
+    return true;
+}
+
+bool ViBe_MaskWriter::Save(const char* filename, vil_image_view<unsigned char>& mask)
+{
+    char header[32];
+    int headerSize = sprintf(header, "P5\n%u %u\n255\n", mask.ni(), mask.nj());
+    unsigned long size = headerSize + mask.ni()*mask.nj();
+    if (buffer.size() < size)
+    {
+        buffer.resize(size);
+    }
+
+    unsigned char* dst = &buffer[0];
+    for (int k = 0; k < headerSize; k++)
+    {
+        *dst++ = header[k];
+    }
+    for (unsigned j = 0; j < mask.nj(); j++)
+    {
+        for (unsigned i = 0; i < mask.ni(); i++)
+        {
+            *dst++ = mask(i,j,0);
+        }
+    }
+
+    int file = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (file < 0)
+    {
+        return false;
+    }
+    bool ok = write(file, &buffer[0], size) == (int)size;
+    close(file);
+    return ok;
+}
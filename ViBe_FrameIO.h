@@ -0,0 +1,134 @@
+#ifndef __VIBE_FRAME_IO_H__
+#define __VIBE_FRAME_IO_H__
+
+#include <vil/vil_image_view.h>
+
+#include "ViBe_Model.h"
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+struct ViBe_JpegState;
+
+/*
+ * Receives the mask of a frame a group of rows at a time from ViBe_FrameDecoder::SegmentFile / SegmentMemory
+ */
+class ViBe_MaskRowConsumer
+{
+public:
+    virtual ~ViBe_MaskRowConsumer() {}
+
+    /*
+     * maskRows - single plane mask of rows firstRow to firstRow + maskRows.nj() - 1 of the frame, only valid for the
+     *            duration of the call
+     */
+    virtual void MaskRows(vil_image_view<unsigned char>& maskRows, int firstRow) = 0;
+};
+
+/*
+ * JPEG decoder that recycles all of its buffers between frames, so that once it has seen a frame of the largest size
+ * it will decode into, decoding makes no further heap allocations:
+ *  - the file is read with unbuffered I/O into a byte buffer that only ever grows
+ *  - the decompressor is created once and reused for every frame
+ *  - libjpeg's per image memory pool is served from an arena that is reset rather than freed after each frame
+ *  - pixels are decoded straight into a buffer that getImage() wraps without copying
+ * Files that are not JPEGs are loaded with vil_load, which does allocate.
+ */
+class ViBe_FrameDecoder
+{
+public:
+    ViBe_FrameDecoder();
+    ~ViBe_FrameDecoder();
+
+    /*
+     * Read and decode a file, returns false if it can't be read or decoded
+     */
+    bool DecodeFile(const char* filename);
+
+    /*
+     * Decode a JPEG that is already in memory, returns false if it can't be decoded
+     */
+    bool DecodeMemory(const unsigned char* data, unsigned long size);
+
+    /*
+     * The last decoded frame, a 3 plane image (grayscale JPEGs are presented as 3 identical planes). The view points
+     * into the decoder's buffer and is overwritten by the next decode
+     */
+    vil_image_view<unsigned char>& getImage();
+
+    /*
+     * Fused decoding and segmentation of a JPEG. Each MCU row (8 or 16 rows of pixels, fewer when scaled) is segmented by model as soon
+     * as it is decoded, and its mask passed to consumer, so the frame is never held in full and the rows are still
+     * in cache when they are segmented. Needs model.canSegmentBands(), otherwise (or for files that aren't JPEGs) the
+     * frame is decoded in full and passed to Segment, and its mask handed to consumer in the same groups of rows.
+     * Returns false if the frame can't be read or decoded, or isn't the size of the model
+     */
+    bool SegmentFile(const char* filename, ViBe_Model& model, ViBe_MaskRowConsumer& consumer);
+    bool SegmentMemory(const unsigned char* data, unsigned long size, ViBe_Model& model,
+                       ViBe_MaskRowConsumer& consumer);
+
+    /*
+     * Reduced decoding for the reduced modes, which only apply to JPEGs (other files are loaded at full size in colour):
+     * SetScale -     decode at 1/Denominator of the full size (1, 2, 4 or 8), scaled in the DCT domain so the skipped
+     *                resolution is never reconstructed
+     * SetGrayscale - decode only the luma of colour JPEGs, so the chroma is neither transformed, upsampled nor colour
+     *                converted. The frames are still presented as 3 (identical) planes
+     */
+    void SetScale(int Denominator);
+    void SetGrayscale(bool enable);
+    int getScale();
+    bool isGrayscale();
+
+    /*
+     * Only decode a region of interest of JPEGs, given in full size pixels (a zero Width or Height decodes the whole
+     * frame). Rows above the region are skipped and decoding stops after its last row. Built against libjpeg-turbo
+     * 1.5 or later the rows above are skipped without being decoded and only the MCU columns covering the region are
+     * decoded (chroma upsampling at the edge of those columns can shift a pixel by a level), with other libjpeg builds the rows above are decoded and discarded and whole rows are decoded. The frame
+     * presented (or segmented) is just the region, so the model should be the size of the region
+     */
+    void SetCrop(int X, int Y, int Width, int Height);
+
+    static bool isJpeg(const unsigned char* data, unsigned long size);
+
+protected:
+    bool ReadFile(const char* filename);
+    bool SegmentImage(ViBe_Model& model, ViBe_MaskRowConsumer& consumer);
+    bool StartDecompress(const unsigned char* data, unsigned long size, unsigned& ni, unsigned& nj,
+                         unsigned& columnOffset);
+    void FinishDecompress();
+
+private:
+    ViBe_FrameDecoder(const ViBe_FrameDecoder&);
+    ViBe_FrameDecoder& operator=(const ViBe_FrameDecoder&);
+
+    ViBe_JpegState* jpeg;                   // decompressor, error handling and memory pool, kept between frames
+    vcl_vector<unsigned char> fileBuffer;   // contents of the last file read
+    unsigned long fileSize;                 // bytes of fileBuffer in use
+    int scale;                              // decode at 1/scale of the full size
+    bool grayscale;                         // decode only the luma
+    int cropX;                              // region of interest in full size pixels, cropWidth is 0 if there's none
+    int cropY;
+    int cropWidth;
+    int cropHeight;
+    vcl_vector<unsigned char> pixelBuffer;  // decoded pixels, interleaved
+    vil_image_view<unsigned char> image;    // view of pixelBuffer
+    vcl_vector<unsigned char> rowBuffer;    // one MCU row of decoded pixels for SegmentMemory, or a skipped row
+    vcl_vector<unsigned char> maskBuffer;   // mask of an MCU row, or of the whole frame when segmenting it in full
+};
+
+/*
+ * Saves single plane masks as binary PGM files, formatting into a recycled buffer and writing with unbuffered I/O
+ * so that saving makes no heap allocations once the buffer has reached the mask size
+ */
+class ViBe_MaskWriter
+{
+public:
+    bool Save(const char* filename, vil_image_view<unsigned char>& mask);
+
+private:
+    vcl_vector<unsigned char> buffer;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "ViBe_Manifest.h"
+#include "ViBe_Follow.h"
+
+#include <vul/vul_file_iterator.h>
+
+#ifndef _VUL_FILE_
+#define _VUL_FILE_
+#include <vul/vul_file.h>
+#endif
+
+#ifndef _VCL_ALGORITHM_
+#define _VCL_ALGORITHM_
+#include <vcl_algorithm.h>
+#endif
+
+#ifndef _VCL_UTILITY_
+#define _VCL_UTILITY_
+#include <vcl_utility.h>
+#endif
+
+#ifndef _LIMITS_
+#define _LIMITS_
+#include <limits.h>
+#endif
+
+#define MANIFEST_MAGIC 0x464D4256       // "VBMF"
+#define MANIFEST_VERSION 1
+#define MANIFEST_HEADER_WORDS 4
+#define MANIFEST_MAX_FRAME 0xFFFFFFFFUL    // frame numbers are stored as 32 bit words
+
+static unsigned long read32(const unsigned char* p)
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void write32(unsigned char* p, unsigned long value)
+{
+    p[0] = (unsigned char)(value);
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+ViBe_FrameManifest::ViBe_FrameManifest()
+{
+    nameSize = 0;
+    file = NULL;
+    nameStart = 0;
+}
+
+ViBe_FrameManifest::~ViBe_FrameManifest()
+{
+    Close();
+}
+
+void ViBe_FrameManifest::Close()
+{
+    if (file != NULL)
+    {
+        fclose(file);
+        file = NULL;
+    }
+    frameNumbers.clear();
+    nameOffsets.clear();
+    names.clear();
+    nameSize = 0;
+}
+
+bool ViBe_FrameManifest::Build(const vcl_string& Directory, const vcl_string& extension)
+{
+    Close();
+    directory = Directory;
+
+    vcl_vector< vcl_pair<long, vcl_string> > frames;
+    for (vul_file_iterator fn=(directory + "/*" + extension); fn; ++fn)
+    {
+        if (vul_file::is_directory(fn()))
+        {
+            continue;
+        }
+        vcl_string path = fn();
+        long frameNumber = ViBe_DirectoryWatcher::FrameNumber(path);
+        /// i.e. a timestamp such as cam_20261017140031.jpg, which would be truncated
+        if ((frameNumber == LONG_MAX) || ((unsigned long)frameNumber > MANIFEST_MAX_FRAME))
+        {
+            Close();
+            return false;
+        }
+        if (frameNumber >= 0)
+        {
+            vcl_string::size_type nameStart = path.find_last_of("/\\");
+            frames.push_back(vcl_make_pair(frameNumber,
+                                           (nameStart == vcl_string::npos) ? path : path.substr(nameStart + 1)));
+        }
+    }
+    /// frames with the same number (if any) are kept in order of name
+    vcl_sort(frames.begin(), frames.end());
+
+    frameNumbers.resize(frames.size());
+    nameOffsets.resize(frames.size());
+    for (unsigned k = 0; k < frames.size(); k++)
+    {
+        frameNumbers[k] = frames[k].first;
+        nameOffsets[k] = names.size();
+        names.insert(names.end(), frames[k].second.begin(), frames[k].second.end());
+        names.push_back('\0');
+    }
+    nameSize = names.size();
+    return !frames.empty();
+}
+
+bool ViBe_FrameManifest::Save(const vcl_string& filename)
+{
+    if (names.size() != nameSize)
+    {
+        return false;
+    }
+    vcl_vector<unsigned char> table(MANIFEST_HEADER_WORDS*4 + frameNumbers.size()*8);
+    write32(&table[0], MANIFEST_MAGIC);
+    write32(&table[4], MANIFEST_VERSION);
+    write32(&table[8], frameNumbers.size());
+    write32(&table[12], nameSize);
+    for (unsigned k = 0; k < frameNumbers.size(); k++)
+    {
+        write32(&table[MANIFEST_HEADER_WORDS*4 + k*8], frameNumbers[k]);
+        write32(&table[MANIFEST_HEADER_WORDS*4 + k*8 + 4], nameOffsets[k]);
+    }
+
+    /// written under a temporary name and renamed, so a job starting meanwhile never opens a partial manifest
+    vcl_string temporary = filename + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (out == NULL)
+    {
+        return false;
+    }
+    bool written = (fwrite(&table[0], 1, table.size(), out) == table.size()) &&
+                   (names.empty() || (fwrite(&names[0], 1, names.size(), out) == names.size()));
+    written = (fclose(out) == 0) && written;
+    if (!written)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    remove(filename.c_str());
+    return rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+bool ViBe_FrameManifest::Open(const vcl_string& filename, const vcl_string& Directory)
+{
+    Close();
+    directory = Directory;
+    file = fopen(filename.c_str(), "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    unsigned char header[MANIFEST_HEADER_WORDS*4];
+    if ((fread(header, 1, sizeof(header), file) != sizeof(header)) || (read32(header) != MANIFEST_MAGIC) ||
+        (read32(header + 4) != MANIFEST_VERSION))
+    {
+        Close();
+        return false;
+    }
+    unsigned long numFrames = read32(header + 8);
+    nameSize = read32(header + 12);
+    /// so that a corrupt count can't cause a huge allocation
+    if ((fseek(file, 0, SEEK_END) != 0) ||
+        ((unsigned long)ftell(file) != MANIFEST_HEADER_WORDS*4 + numFrames*8 + nameSize) ||
+        (fseek(file, MANIFEST_HEADER_WORDS*4, SEEK_SET) != 0))
+    {
+        Close();
+        return false;
+    }
+
+    vcl_vector<unsigned char> table(numFrames*8);
+    if ((numFrames > 0) && (fread(&table[0], 1, table.size(), file) != table.size()))
+    {
+        Close();
+        return false;
+    }
+    frameNumbers.resize(numFrames);
+    nameOffsets.resize(numFrames);
+    for (unsigned long k = 0; k < numFrames; k++)
+    {
+        frameNumbers[k] = (long)read32(&table[k*8]);
+        nameOffsets[k] = read32(&table[k*8 + 4]);
+        if ((nameOffsets[k] >= nameSize) || ((k > 0) && ((frameNumbers[k] < frameNumbers[k - 1]) ||
+                                                          (nameOffsets[k] <= nameOffsets[k - 1]))))
+        {
+            Close();
+            return false;
+        }
+    }
+    nameStart = MANIFEST_HEADER_WORDS*4 + numFrames*8;
+    return true;
+}
+
+int ViBe_FrameManifest::getNumFrames()
+{
+    return frameNumbers.size();
+}
+
+long ViBe_FrameManifest::getFrameNumber(int index)
+{
+    return frameNumbers[index];
+}
+
+int ViBe_FrameManifest::Seek(long frameNumber)
+{
+    return vcl_lower_bound(frameNumbers.begin(), frameNumbers.end(), frameNumber) - frameNumbers.begin();
+}
+
+bool ViBe_FrameManifest::GetRange(long firstFrame, long lastFrame, vcl_vector<vcl_string>& filenames)
+{
+    int first = Seek(firstFrame);
+    int last = (lastFrame < 0) ? getNumFrames() : Seek(lastFrame + 1);
+    if (first >= last)
+    {
+        return true;
+    }
+
+    /// the names of a range are contiguous, so they are read in one go
+    unsigned long start = nameOffsets[first];
+    unsigned long end = (last < getNumFrames()) ? nameOffsets[last] : nameSize;
+    vcl_vector<char> block;
+    const char* rangeNames;
+    if (file != NULL)
+    {
+        block.resize(end - start);
+        if ((fseek(file, nameStart + start, SEEK_SET) != 0) || (fread(&block[0], 1, block.size(), file) != block.size()) ||
+            (block.back() != '\0'))
+        {
+            return false;
+        }
+        rangeNames = &block[0];
+    }
+    else
+    {
+        rangeNames = &names[start];
+    }
+
+    for (int k = first; k < last; k++)
+    {
+        filenames.push_back(directory + "/" + (rangeNames + (nameOffsets[k] - start)));
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef __VIBE_MANIFEST_H__
+#define __VIBE_MANIFEST_H__
+
+#ifndef _VCL_STRING_
+#define _VCL_STRING_
+#include <vcl_string.h>
+#endif
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+#ifndef _STDIO_
+#define _STDIO_
+#include <stdio.h>
+#endif
+
+/*
+ * Index of the frames in a directory, so that directories of millions of frames only have to be listed once. The
+ * manifest is built by listing the directory, and saved to a file that later runs open instead.
+ *
+ * Frames are ordered by frame number, the last run of digits in the file name (files without one are left out), and
+ * selected by a range of frame numbers. Opening a manifest only reads the table of frame numbers, the names of the
+ * frames in a range are read from the file when the range is asked for, so a job on a sub-range of a huge
+ * directory starts at once.
+ *
+ * The file is a header of little endian 32 bit words:
+ *   magic, version, number of frames, size of the name block
+ * followed by a table of (frame number, offset of the name in the name block) word pairs in order of frame number,
+ * and the name block of NUL terminated file names relative to the directory.
+ */
+class ViBe_FrameManifest
+{
+public:
+    ViBe_FrameManifest();
+    ~ViBe_FrameManifest();
+
+    /*
+     * List the files of directory with the given extension (a glob such as *jpeg), returns false if there are none or
+     * if a frame number is above 0xFFFFFFFF (or too large for a long), which the file can't hold
+     */
+    bool Build(const vcl_string& directory, const vcl_string& extension);
+
+    bool Save(const vcl_string& filename);
+
+    /*
+     * Open a saved manifest of the frames in directory, returns false if it can't be read or is corrupt
+     */
+    bool Open(const vcl_string& filename, const vcl_string& directory);
+
+    int getNumFrames();
+    long getFrameNumber(int index);
+
+    /*
+     * Index of the first frame numbered frameNumber or later, getNumFrames() if there is none
+     */
+    int Seek(long frameNumber);
+
+    /*
+     * The paths of the frames numbered firstFrame to lastFrame (inclusive, lastFrame < 0 for no limit), appended to
+     * filenames in order. Returns false if the names can't be read
+     */
+    bool GetRange(long firstFrame, long lastFrame, vcl_vector<vcl_string>& filenames);
+
+private:
+    ViBe_FrameManifest(const ViBe_FrameManifest&);
+    ViBe_FrameManifest& operator=(const ViBe_FrameManifest&);
+
+    void Close();
+
+    vcl_string directory;
+    vcl_vector<long> frameNumbers;
+    vcl_vector<unsigned long> nameOffsets;
+    unsigned long nameSize;                 // size of the name block
+    vcl_vector<char> names;                 // the name block when built, empty when opened
+    FILE* file;                             // the opened manifest, names are read from it on demand
+    long nameStart;                         // offset of the name block in file
+};
+
+#endif
@@ -25,21 +25,89 @@
 #include <time.h>
 #endif
 
+#ifndef _VCL_ALGORITHM_
+#define _VCL_ALGORITHM_
+#include <vcl_algorithm.h>
+#endif
+
 ViBe_Model::ViBe_Model()
 {
-
+    trackDirty = false;
+    tilesAcross = 0;
+    numDirty = 0;
+    packedMatching = false;
+    packedStorage = NULL;
+    packedSamples = NULL;
+    model = NULL;
+    randomNumberGenerator = NULL;
+    width = 0;
+    height = 0;
 }
 
 ViBe_Model::~ViBe_Model()
 {
+    this->Free();
+}
+
+void ViBe_Model::Free()
+{
+    if (model != NULL)
+    {
+        for (int i=0; i<width; i++)
+        {
+            for (int j=0; j<height; j++)
+            {
+                delete model[i][j];
+            }
+            delete [] model[i];
+        }
+        delete [] model;
+        model = NULL;
+    }
+    delete [] packedStorage;
+    packedStorage = NULL;
+    packedSamples = NULL;
+    packedMatching = false;
+    trackDirty = false;
+    dirtyPixels.clear();
+    dirtyTiles.clear();
+    numDirty = 0;
+    delete randomNumberGenerator;
+    randomNumberGenerator = NULL;
+    for (unsigned b=0; b<bandRandom.size(); b++)
+    {
+        delete bandRandom[b];
+    }
+    bandRandom.clear();
 }
 
 void ViBe_Model::Init(int Samples, int Radius, int MinSamplesBackground, int RandomSubsampling, int Width, int Height)
 {
+    /// initialising again starts from scratch, like the other settings packed matching and dirty tracking are off
+    this->Free();
     samples = Samples;
     radius = Radius;
     minSamplesBackground = MinSamplesBackground;
     randomSubsampling = RandomSubsampling;
+    updateInterval = 1;
+    frameCount = 0;
+    distanceMode = DISTANCE_RGB;
+    sortedMatching = false;
+    envelopeRejection = false;
+    approximateSamples = 0;
+    checkerboard = false;
+    lastForegroundCount = 0;
+    illuminationMode = ILLUMINATION_OFF;
+    illuminationThreshold = ILLUMINATION_THRESHOLD;
+    illuminationFrames = ILLUMINATION_FRAMES;
+    illuminationFramesLeft = 0;
+    illuminationChanges = 0;
+    averageForeground = 0;
+    reclassifying = false;
+    jitterMaxShift = 0;
+    jitterX = 0;
+    jitterY = 0;
+    referenceFrame = 0;
     width = Width;
     height = Height;
 
@@ -80,21 +148,21 @@ void ViBe_Model::Init(int Samples, int Radius, int MinSamplesBackground, int Ran
 void ViBe_Model::InitBackground(int numTrainingImages, vcl_vector<vcl_string> filenames)
 {
     //vcl_cout << numTrainingImages << vcl_endl;
+    if (numTrainingImages > (int)filenames.size())
+    {
+        numTrainingImages = filenames.size();
+    }
+
+    /// decode the training frames concurrently, each frame is independent of the others
+    vcl_vector< vil_image_view<unsigned char> > trainingImages(numTrainingImages);
+    #pragma omp parallel for schedule(dynamic)
     for (int n = 0; n < numTrainingImages; n++)
     {
-        vil_image_view<unsigned char> inputImage = vil_load(filenames[n].c_str());
-        for (int i=0; i<inputImage.ni(); i++)
-        {
-            for (int j=0; j<inputImage.nj(); j++)
-            {
-                unsigned char pixel[3] = { inputImage(i,j,0),inputImage(i,j,1),inputImage(i,j,2) };
+        trainingImages[n] = vil_load(filenames[n].c_str());
+    }
 
-                ViBe_Pixel* background_memory = model[i][j];
+    this->InitBackground(trainingImages);
 
-                background_memory->addSample(pixel);
-            }
-        }
-    }
     ///Checking that the data structure is working correctly
     /*
     vil_image_view<unsigned char> inputImage = vil_load(filenames[15].c_str());
@@ -105,70 +173,593 @@ void ViBe_Model::InitBackground(int numTrainingImages, vcl_vector<vcl_string> fi
     {
         for (int j=0; j<inputImage.nj(); j++)
         {
-            unsigned char** samples = model[i][j]->getSamples();
-            checkBackground(i,j,0) = samples[15][0];
-            checkBackground(i,j,1) =samples[15][1];
-            checkBackground(i,j,2) =samples[15][2];
+            unsigned char sample[3];
+            model[i][j]->getSample(15, sample);
+            checkBackground(i,j,0) = sample[0];
+            checkBackground(i,j,1) =sample[1];
+            checkBackground(i,j,2) =sample[2];
         }
     }
     vil_save(checkBackground, "CheckBackground.jpeg");
     */
 }
 
+void ViBe_Model::InitBackground(vcl_vector< vil_image_view<unsigned char> >& trainingImages)
+{
+    int numSlots = trainingImages.size();
+    if (numSlots > NUM_SAMPLES)
+    {
+        numSlots = NUM_SAMPLES;
+    }
+
+    /// training image n is simply sample slot n, so each row of the model can be filled independently
+    #pragma omp parallel for
+    for (int j=0; j<height; j++)
+    {
+        for (int i=0; i<width; i++)
+        {
+            ViBe_Pixel* background_memory = model[i][j];
+            for (int n = 0; n < numSlots; n++)
+            {
+                vil_image_view<unsigned char>& inputImage = trainingImages[n];
+                unsigned char pixel[3] = { inputImage(i,j,0),inputImage(i,j,1),inputImage(i,j,2) };
+                background_memory->FillSample(pixel, n);
+            }
+            background_memory->RebuildFeatures();
+            background_memory->setNumSamples(numSlots);
+        }
+    }
+    this->MarkAllDirty();
+    referenceColumns.clear();
+}
+
+void ViBe_Model::InitBackground(vil_image_view<unsigned char>& frame)
+{
+    this->Reseed(frame);
+    lastForegroundCount = 0;
+    averageForeground = 0;
+    illuminationFramesLeft = 0;
+    if (checkerboard)
+    {
+        previousMask.assign(width*height, BACKGROUND);
+    }
+}
+
+bool ViBe_Model::SwapScene(ViBe_Model& other)
+{
+    if ((width != other.width) || (height != other.height) || (packedMatching != other.packedMatching))
+    {
+        return false;
+    }
+    /// the packed blocks are attached to the pixels, so they move with them
+    vcl_swap(model, other.model);
+    vcl_swap(packedStorage, other.packedStorage);
+    vcl_swap(packedSamples, other.packedSamples);
+    previousMask.swap(other.previousMask);
+    referenceColumns.swap(other.referenceColumns);
+    referenceRows.swap(other.referenceRows);
+    vcl_swap(referenceFrame, other.referenceFrame);
+    vcl_swap(lastForegroundCount, other.lastForegroundCount);
+    vcl_swap(averageForeground, other.averageForeground);
+    if (checkerboard && (previousMask.size() != (unsigned)(width*height)))
+    {
+        previousMask.assign(width*height, BACKGROUND);
+    }
+    if (other.checkerboard && (other.previousMask.size() != (unsigned)(width*height)))
+    {
+        other.previousMask.assign(width*height, BACKGROUND);
+    }
+    /// the sample features move with the pixels, each model keeps those its own settings use
+    this->UpdatePixelFeatures();
+    other.UpdatePixelFeatures();
+    this->MarkAllDirty();
+    other.MarkAllDirty();
+    return true;
+}
+
 // output is a single plane image
 void ViBe_Model::Segment(vil_image_view<unsigned char>& input, vil_image_view<unsigned char>& output)
 {
+    FrameSettings frame = this->NextFrame();
+    bool updateFrame = frame.updateFrame;
+    int subsampling = frame.subsampling;
+    bool adapting = frame.adapting;
+
+    /// camera jitter, each input pixel (i,j) is compared to model pixel (i+jitterX, j+jitterY)
+    if ((jitterMaxShift > 0) && !reclassifying)
+    {
+        this->EstimateJitter(input);
+    }
+
+    int approximateFirst = frame.approximateFirst;
+
+    /// with checkerboard classification, pixels with (i + j + parity) odd are skipped and filled in afterwards. A frame
+    /// classified again after re-seeding is classified in full, as its mask of the frame before is the mask of the
+    /// lighting change it is being classified again for
+    bool skipping = checkerboard && !reclassifying;
+    int parity = frameCount & 1;
+
+    int foregroundCount = 0;
+    int cellCounts[ILLUMINATION_GRID*ILLUMINATION_GRID] = { 0 };
+
     for (int i=0; i< input.ni(); i++)
     {
+        int cellX = (i*ILLUMINATION_GRID) / width;
+        /// pixels that have moved in from outside the model are compared to its border, but don't update it
+        int mi = i + jitterX;
+        bool outsideX = (mi < 0) || (mi >= width);
+        mi = (mi < 0) ? 0 : ((mi >= width) ? width - 1 : mi);
         for (int j=0; j< input.nj(); j++)
         {
+            if (skipping && ((i + j + parity) & 1))
+            {
+                continue;
+            }
             unsigned char pixel[3] = { input(i,j,0),input(i,j,1),input(i,j,2) };
+            int mj = j + jitterY;
+            bool outside = outsideX || (mj < 0) || (mj >= height);
+            mj = (mj < 0) ? 0 : ((mj >= height) ? height - 1 : mj);
+            ViBe_Pixel* background_model = model[mi][mj];
 
             // 1. Compare pixel to background model
-            int count = model[i][j]->ComparePixel( *(model[i][j]), pixel);
+            int count = this->ClassifyPixel(background_model, pixel, approximateFirst);
             /// Foreground or background? If our pixel is similar to at least
-            /// MINSAMPLES pixels, then we have seen this colour before, and
+            /// minSamplesBackground pixels, then we have seen this colour before, and
             /// the pixel is background.
             //vcl_cout << count << vcl_endl;
             int rand;
-            if (count >= MINSAMPLES)
+            if (count >= minSamplesBackground)
             {
                 output(i,j,0) = BACKGROUND;
-                //update current pixel model
-                rand = randomNumberGenerator->lrand32(randomSubsampling-1);
-                //vcl_cout << rand << vcl_endl;
-                if (rand == 0)
+            }
+            else
+            {
+                output(i,j,0) = FOREGROUND;
+                foregroundCount++;
+                cellCounts[((j*ILLUMINATION_GRID) / height)*ILLUMINATION_GRID + cellX]++;
+                /// only background pixels update the model, unless we're adapting to a lighting change
+                if (!adapting)
                 {
-                    this->UpdateModel( *(model[i][j]), pixel);
+                    continue;
                 }
-                // update a random neighbouring pixel's model
-                rand = randomNumberGenerator->lrand32(randomSubsampling-1);
-                if (rand == 0)
-                {
-                    int newX; int newY;
-                    //vcl_cout << i << vcl_endl;
-                    //vcl_cout << j << vcl_endl;
-                    this->PickNeighbour(i,j,newX,newY,input);
+            }
+
+            if (!updateFrame || outside)
+            {
+                continue;
+            }
+            //update current pixel model
+            rand = randomNumberGenerator->lrand32(subsampling-1);
+            //vcl_cout << rand << vcl_endl;
+            if (rand == 0)
+            {
+                this->UpdateModel( *background_model, pixel);
+                this->MarkDirty(mi,mj);
+            }
+            // update a random neighbouring pixel's model
+            rand = randomNumberGenerator->lrand32(subsampling-1);
+            if (rand == 0)
+            {
+                int newX; int newY;
+                //vcl_cout << i << vcl_endl;
+                //vcl_cout << j << vcl_endl;
+                this->PickNeighbour(mi,mj,newX,newY,input);
+
+                //vcl_cout << newX << vcl_endl;
+                //vcl_cout << newY << vcl_endl;
 
-                    //vcl_cout << newX << vcl_endl;
-                    //vcl_cout << newY << vcl_endl;
+                this->UpdateModel( *(model[newX][newY]), pixel);
+                this->MarkDirty(newX,newY);
 
-                    this->UpdateModel( *(model[newX][newY]), pixel);
+            }
+        }
+    }
+    //vil_save(output,"TestImage.jpeg");
 
+    if (skipping)
+    {
+        for (int j=0; j<height; j++)
+        {
+            for (int i=(j + parity + 1) & 1; i<width; i+=2)
+            {
+                /// the 4 neighbours of a skipped pixel were all classified this frame
+                int votes = (previousMask[j*width + i] == FOREGROUND) ? 1 : 0;
+                int voters = 1;
+                if (i > 0)
+                {
+                    votes += (output(i-1,j,0) == FOREGROUND); voters++;
                 }
+                if (i < width-1)
+                {
+                    votes += (output(i+1,j,0) == FOREGROUND); voters++;
+                }
+                if (j > 0)
+                {
+                    votes += (output(i,j-1,0) == FOREGROUND); voters++;
+                }
+                if (j < height-1)
+                {
+                    votes += (output(i,j+1,0) == FOREGROUND); voters++;
+                }
+                bool foreground = (2*votes == voters) ? (previousMask[j*width + i] == FOREGROUND) : (2*votes > voters);
+                output(i,j,0) = foreground ? FOREGROUND : BACKGROUND;
+                if (foreground)
+                {
+                    foregroundCount++;
+                    cellCounts[((j*ILLUMINATION_GRID) / height)*ILLUMINATION_GRID + (i*ILLUMINATION_GRID) / width]++;
+                }
+            }
+        }
+    }
+    if (checkerboard)
+    {
+        for (int j=0; j<height; j++)
+        {
+            for (int i=0; i<width; i++)
+            {
+                previousMask[j*width + i] = output(i,j,0);
+            }
+        }
+    }
+
+    lastForegroundCount = foregroundCount;
+    if (!reclassifying)
+    {
+        this->DetectIlluminationChange(input, output, cellCounts);
+    }
+}
+
+int ViBe_Model::ClassifyPixel(ViBe_Pixel* background_model, unsigned char* pixel, int approximateFirst)
+{
+    if (distanceMode == DISTANCE_CHROMA)
+    {
+        return background_model->ComparePixelChroma(pixel, minSamplesBackground);
+    }
+    if (approximateSamples > 0)
+    {
+        int count = background_model->ComparePixelSubset(pixel, approximateFirst, approximateSamples, radius,
+                                                         minSamplesBackground);
+        if ((count > 0) && (count < minSamplesBackground))
+        {
+            count = background_model->ComparePixel( *background_model, pixel, radius, minSamplesBackground);
+        }
+        return count;
+    }
+    if (packedMatching)
+    {
+        return background_model->ComparePixelPacked(pixel, radius, minSamplesBackground);
+    }
+    if (sortedMatching)
+    {
+        return background_model->ComparePixelSorted(pixel, radius, minSamplesBackground);
+    }
+    return background_model->ComparePixel( *background_model, pixel, radius, minSamplesBackground);
+}
+
+bool ViBe_Model::canSegmentBands()
+{
+    return (illuminationMode == ILLUMINATION_OFF) && (jitterMaxShift == 0) && !checkerboard && !trackDirty;
+}
+
+void ViBe_Model::SegmentWavefront(vcl_vector< vil_image_view<unsigned char> >& inputs,
+                                  vcl_vector< vil_image_view<unsigned char> >& outputs, int numBands)
+{
+    int numFrames = inputs.size();
+    if (!this->canSegmentBands())
+    {
+        for (int t=0; t<numFrames; t++)
+        {
+            this->Segment(inputs[t], outputs[t]);
+        }
+        return;
+    }
+    if (numFrames == 0)
+    {
+        return;
+    }
+    /// bands of at least 2 rows, so the rows two neighbouring tasks of a wave write to never meet
+    if (numBands > height / 2)
+    {
+        numBands = height / 2;
+    }
+    if (numBands < 1)
+    {
+        numBands = 1;
+    }
+    if ((int)bandRandom.size() != numBands)
+    {
+        for (unsigned b=0; b<bandRandom.size(); b++)
+        {
+            delete bandRandom[b];
+        }
+        bandRandom.resize(numBands);
+        for (int b=0; b<numBands; b++)
+        {
+            bandRandom[b] = new vnl_random(9667566 + b);
+        }
+    }
+
+    vcl_vector<FrameSettings> frames(numFrames);
+    for (int t=0; t<numFrames; t++)
+    {
+        frames[t] = this->NextFrame();
+    }
+
+    /// task (t,b) is band b of frame t. It needs (t,b-1) and (t-1,b-1..b+1) to have finished, which are all on earlier
+    /// waves w = 2t + b, so the tasks of one wave run in parallel and the waves run in order
+    vcl_vector<int> counts(numFrames*numBands, 0);
+    int numWaves = 2*(numFrames - 1) + numBands;
+    for (int w=0; w<numWaves; w++)
+    {
+        int firstFrame = (w - numBands + 2) / 2;
+        firstFrame = (firstFrame > 0) ? firstFrame : 0;
+        int lastFrame = (w / 2 < numFrames - 1) ? w / 2 : numFrames - 1;
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int t=firstFrame; t<=lastFrame; t++)
+        {
+            int b = w - 2*t;
+            counts[t*numBands + b] = this->SegmentBand(inputs[t], outputs[t], 0, (b*height) / numBands,
+                                                       ((b + 1)*height) / numBands, frames[t], *bandRandom[b]);
+        }
+    }
+
+    lastForegroundCount = 0;
+    for (int b=0; b<numBands; b++)
+    {
+        lastForegroundCount += counts[(numFrames - 1)*numBands + b];
+    }
+}
+
+ViBe_Model::FrameSettings ViBe_Model::NextFrame()
+{
+    FrameSettings frame;
+    /// with temporal decimation, frames in between update frames are only classified
+    frame.updateFrame = (frameCount % updateInterval) == 0;
+    frame.subsampling = randomSubsampling / updateInterval;
+    if (checkerboard)
+    {
+        /// each pixel is only classified every other frame, so updates when it is at twice the rate
+        frame.subsampling /= 2;
+    }
+    if (frame.subsampling < 1)
+    {
+        frame.subsampling = 1;
+    }
+    /// while adapting to a lighting change every pixel updates the model, at a much higher rate
+    frame.adapting = (illuminationMode == ILLUMINATION_FAST_UPDATE) && (illuminationFramesLeft > 0);
+    if (frame.adapting)
+    {
+        frame.updateFrame = true;
+        frame.subsampling = ILLUMINATION_SUBSAMPLING;
+    }
+    /// a frame classified again after re-seeding doesn't update the model, and isn't counted twice
+    if (reclassifying)
+    {
+        frame.updateFrame = false;
+        frame.adapting = false;
+    }
+    else
+    {
+        frameCount++;
+    }
+    /// approximate matching compares a window of the samples that moves on every frame
+    frame.approximateFirst = (approximateSamples > 0) ? (frameCount*approximateSamples) % NUM_SAMPLES : 0;
+    return frame;
+}
+
+void ViBe_Model::BeginRows()
+{
+    rowsFrame = this->NextFrame();
+    rowsForegroundCount = 0;
+}
+
+void ViBe_Model::SegmentRows(vil_image_view<unsigned char>& rows, vil_image_view<unsigned char>& maskRows, int firstRow)
+{
+    int lastRow = firstRow + rows.nj();
+    if (lastRow > height)
+    {
+        lastRow = height;
+    }
+    rowsForegroundCount += this->SegmentBand(rows, maskRows, firstRow, firstRow, lastRow, rowsFrame,
+                                             *randomNumberGenerator);
+}
+
+void ViBe_Model::EndRows()
+{
+    lastForegroundCount = rowsForegroundCount;
+}
+
+int ViBe_Model::SegmentBand(vil_image_view<unsigned char>& input, vil_image_view<unsigned char>& output, int rowOffset,
+                            int firstRow, int lastRow, const FrameSettings& frame, vnl_random& random)
+{
+    int foregroundCount = 0;
+    for (int j=firstRow; j<lastRow; j++)
+    {
+        for (int i=0; i<width; i++)
+        {
+            int r = j - rowOffset;
+            unsigned char pixel[3] = { input(i,r,0),input(i,r,1),input(i,r,2) };
+            ViBe_Pixel* background_model = model[i][j];
+            if (this->ClassifyPixel(background_model, pixel, frame.approximateFirst) >= minSamplesBackground)
+            {
+                output(i,r,0) = BACKGROUND;
             }
             else
             {
-                output(i,j,0) = FOREGROUND;
+                output(i,r,0) = FOREGROUND;
+                foregroundCount++;
+                continue;
+            }
+            if (!frame.updateFrame)
+            {
+                continue;
+            }
+            if (random.lrand32(frame.subsampling-1) == 0)
+            {
+                background_model->addSample(pixel, random.lrand32(background_model->getNumSamples() - 1));
+            }
+            if (random.lrand32(frame.subsampling-1) == 0)
+            {
+                /// as PickNeighbour, with this band's random numbers
+                int newX; int newY;
+                do
+                {
+                    newX = random.lrand32(1) ? i + 1 : i - 1;
+                    newY = random.lrand32(1) ? j + 1 : j - 1;
+                }
+                while ((newX < 0) || (newX >= width) || (newY < 0) || (newY >= height));
+                model[newX][newY]->addSample(pixel, random.lrand32(model[newX][newY]->getNumSamples() - 1));
             }
+        }
+    }
+    return foregroundCount;
+}
 
+void ViBe_Model::DetectIlluminationChange(vil_image_view<unsigned char>& input, vil_image_view<unsigned char>& output,
+                                          int* cellCounts)
+{
+    if (illuminationMode == ILLUMINATION_OFF)
+    {
+        return;
+    }
+    if (illuminationFramesLeft > 0)
+    {
+        /// still adapting to (or settling after) the last change
+        illuminationFramesLeft--;
+        return;
+    }
 
+    /// lighting changes flood most of the image at once, a large object only covers part of it
+    double fraction = (double)lastForegroundCount / (width*height);
+    double cellArea = (double)(width*height) / (ILLUMINATION_GRID*ILLUMINATION_GRID);
+    int widespread = 0;
+    for (int c=0; c<ILLUMINATION_GRID*ILLUMINATION_GRID; c++)
+    {
+        if (cellCounts[c] >= 0.5*illuminationThreshold*cellArea)
+        {
+            widespread++;
+        }
+    }
 
+    if ((fraction >= illuminationThreshold) && (fraction - averageForeground >= 0.5*illuminationThreshold) &&
+        (4*widespread >= 3*ILLUMINATION_GRID*ILLUMINATION_GRID))
+    {
+        illuminationChanges++;
+        illuminationFramesLeft = illuminationFrames;
+        if (illuminationMode == ILLUMINATION_RESEED)
+        {
+            this->Reseed(input);
+            /// classify the frame again against the new model, so the change doesn't reach the output
+            reclassifying = true;
+            this->Segment(input, output);
+            reclassifying = false;
+        }
+        return;
+    }
+    averageForeground += (fraction - averageForeground) / 16;
+}
 
+/// shift of current against reference (current[k] ~ reference[k + shift]) with the lowest mean absolute difference
+/// between the gradients of the two profiles, which unlike the profiles themselves don't move with overall brightness
+static int BestProfileShift(vcl_vector<long>& current, vcl_vector<long>& reference, int maxShift)
+{
+    int n = current.size() - 1;
+
+    int bestShift = 0;
+    double bestCost = -1;
+    for (int shift=0; shift<=2*maxShift; shift++)
+    {
+        /// try 0, 1, -1, 2, -2 ... so ties go to the smallest shift
+        int s = (shift % 2) ? (shift + 1) / 2 : -(shift / 2);
+        int first = (s < 0) ? -s : 0;
+        int last = (s > 0) ? n - s : n;
+        if (last - first < n / 2)
+        {
+            continue;
+        }
+        double cost = 0;
+        for (int k=first; k<last; k++)
+        {
+            long difference = (current[k+1] - current[k]) - (reference[k+s+1] - reference[k+s]);
+            cost += (difference < 0) ? -difference : difference;
+        }
+        cost /= (last - first);
+        if ((bestCost < 0) || (cost < bestCost))
+        {
+            bestCost = cost;
+            bestShift = s;
+        }
+    }
+    return bestShift;
+}
+
+void ViBe_Model::EstimateJitter(vil_image_view<unsigned char>& input)
+{
+    if ((referenceColumns.size() == 0) || (frameCount - referenceFrame >= JITTER_REFRESH_FRAMES))
+    {
+        /// the reference is the mean of the samples, i.e. the background the model has learnt
+        referenceFrame = frameCount;
+        referenceColumns.assign(width, 0);
+        referenceRows.assign(height, 0);
+        for (int i=0; i<width; i++)
+        {
+            for (int j=0; j<height; j++)
+            {
+                long sum = 0;
+                for (int n=0; n<NUM_SAMPLES; n++)
+                {
+                    unsigned char sample[3];
+                    model[i][j]->getSample(n, sample);
+                    sum += sample[0] + sample[1] + sample[2];
+                }
+                sum /= NUM_SAMPLES;
+                referenceColumns[i] += sum;
+                referenceRows[j] += sum;
+            }
+        }
+    }
+
+    currentColumns.assign(width, 0);
+    currentRows.assign(height, 0);
+    for (int j=0; j<height; j++)
+    {
+        for (int i=0; i<width; i++)
+        {
+            long sum = input(i,j,0) + input(i,j,1) + input(i,j,2);
+            currentColumns[i] += sum;
+            currentRows[j] += sum;
         }
     }
-    //vil_save(output,"TestImage.jpeg");
 
+    jitterX = BestProfileShift(currentColumns, referenceColumns, jitterMaxShift);
+    jitterY = BestProfileShift(currentRows, referenceRows, jitterMaxShift);
+}
+
+void ViBe_Model::Reseed(vil_image_view<unsigned char>& input)
+{
+    /// as when initialising ViBe from a single frame, fill each pixel's samples from its 3x3 neighbourhood
+    for (int i=0; i<width; i++)
+    {
+        for (int j=0; j<height; j++)
+        {
+            for (int n=0; n<NUM_SAMPLES; n++)
+            {
+                int x = i + randomNumberGenerator->lrand32(2) - 1;
+                int y = j + randomNumberGenerator->lrand32(2) - 1;
+                x = (x < 0) ? 0 : ((x >= width) ? width - 1 : x);
+                y = (y < 0) ? 0 : ((y >= height) ? height - 1 : y);
+                unsigned char pixel[3] = { input(x,y,0),input(x,y,1),input(x,y,2) };
+                model[i][j]->FillSample(pixel, n);
+            }
+            model[i][j]->RebuildFeatures();
+            model[i][j]->setNumSamples(NUM_SAMPLES);
+        }
+    }
+    this->MarkAllDirty();
+    /// the shift was against the old model, the new one is aligned with the frame it was drawn from
+    referenceColumns.clear();
+    jitterX = 0;
+    jitterY = 0;
 }
 
 void ViBe_Model::UpdateModel( ViBe_Pixel& background_model, unsigned char* pixel)
@@ -180,6 +771,398 @@ void ViBe_Model::UpdateModel( ViBe_Pixel& background_model, unsigned char* pixel
     background_model.addSample( pixel, rand);
 }
 
+void ViBe_Model::SetUpdateInterval(int Interval)
+{
+    updateInterval = (Interval > 0) ? Interval : 1;
+}
+
+int ViBe_Model::getUpdateInterval()
+{
+    return updateInterval;
+}
+
+void ViBe_Model::SetRandomSubsampling(int RandomSubsampling)
+{
+    randomSubsampling = (RandomSubsampling > 0) ? RandomSubsampling : 1;
+}
+
+int ViBe_Model::getRandomSubsampling()
+{
+    return randomSubsampling;
+}
+
+int ViBe_Model::getFrameCount()
+{
+    return frameCount;
+}
+
+void ViBe_Model::SetDistanceMode(int Mode)
+{
+    distanceMode = Mode;
+    this->UpdatePixelFeatures();
+}
+
+int ViBe_Model::getDistanceMode()
+{
+    return distanceMode;
+}
+
+void ViBe_Model::SetSortedMatching(bool enable)
+{
+    sortedMatching = enable;
+    this->UpdatePixelFeatures();
+}
+
+int ViBe_Model::getPixelFeatures()
+{
+    return ((distanceMode == DISTANCE_CHROMA) ? FEATURE_CHROMA : 0) | (sortedMatching ? FEATURE_ORDER : 0) |
+           (envelopeRejection ? FEATURE_ENVELOPE : 0);
+}
+
+void ViBe_Model::UpdatePixelFeatures()
+{
+    int features = this->getPixelFeatures();
+    for (int i=0; i<width; i++)
+    {
+        for (int j=0; j<height; j++)
+        {
+            model[i][j]->SetFeatures(features);
+        }
+    }
+}
+
+bool ViBe_Model::isSortedMatching()
+{
+    return sortedMatching;
+}
+
+void ViBe_Model::SetEnvelopeRejection(bool enable)
+{
+    envelopeRejection = enable;
+    this->UpdatePixelFeatures();
+}
+
+bool ViBe_Model::isEnvelopeRejection()
+{
+    return envelopeRejection;
+}
+
+void ViBe_Model::SetPackedMatching(bool enable)
+{
+    if (enable == packedMatching)
+    {
+        return;
+    }
+    if (enable)
+    {
+        packedStorage = new unsigned char[width*height*PACKED_BLOCK + PACKED_ALIGN];
+        size_t offset = (size_t)packedStorage % PACKED_ALIGN;
+        packedSamples = packedStorage + ((offset == 0) ? 0 : PACKED_ALIGN - offset);
+    }
+    for (int j=0; j<height; j++)
+    {
+        for (int i=0; i<width; i++)
+        {
+            model[i][j]->AttachPacked(enable ? packedSamples + (j*width + i)*PACKED_BLOCK : NULL);
+        }
+    }
+    if (!enable)
+    {
+        delete [] packedStorage;
+        packedStorage = NULL;
+        packedSamples = NULL;
+    }
+    packedMatching = enable;
+}
+
+bool ViBe_Model::isPackedMatching()
+{
+    return packedMatching;
+}
+
+void ViBe_Model::SetApproximateMatching(int Samples)
+{
+    approximateSamples = ((Samples > 0) && (Samples < NUM_SAMPLES)) ? Samples : 0;
+}
+
+int ViBe_Model::getApproximateMatching()
+{
+    return approximateSamples;
+}
+
+void ViBe_Model::SetCheckerboard(bool enable)
+{
+    checkerboard = enable;
+    if (enable)
+    {
+        previousMask.assign(width*height, BACKGROUND);
+    }
+    else
+    {
+        previousMask.clear();
+    }
+}
+
+bool ViBe_Model::isCheckerboard()
+{
+    return checkerboard;
+}
+
+void ViBe_Model::CopySettings(ViBe_Model& other)
+{
+    this->SetRandomSubsampling(other.randomSubsampling);
+    this->SetUpdateInterval(other.updateInterval);
+    this->SetDistanceMode(other.distanceMode);
+    this->SetSortedMatching(other.sortedMatching);
+    this->SetEnvelopeRejection(other.envelopeRejection);
+    this->SetPackedMatching(other.packedMatching);
+    this->SetApproximateMatching(other.approximateSamples);
+    this->SetCheckerboard(other.checkerboard);
+    this->SetIlluminationAdaptation(other.illuminationMode, other.illuminationThreshold, other.illuminationFrames);
+    this->SetJitterCompensation(other.jitterMaxShift);
+}
+
+void ViBe_Model::SetJitterCompensation(int MaxShift)
+{
+    jitterMaxShift = (MaxShift > 0) ? MaxShift : 0;
+    jitterX = 0;
+    jitterY = 0;
+    referenceColumns.clear();
+}
+
+int ViBe_Model::getJitterX()
+{
+    return jitterX;
+}
+
+int ViBe_Model::getJitterY()
+{
+    return jitterY;
+}
+
+int ViBe_Model::getForegroundCount()
+{
+    return lastForegroundCount;
+}
+
+void ViBe_Model::SetIlluminationAdaptation(int Mode, double Threshold, int Frames)
+{
+    illuminationMode = Mode;
+    illuminationThreshold = Threshold;
+    illuminationFrames = Frames;
+    illuminationFramesLeft = 0;
+}
+
+int ViBe_Model::getIlluminationChanges()
+{
+    return illuminationChanges;
+}
+
+bool ViBe_Model::isAdaptingToIllumination()
+{
+    return (illuminationMode != ILLUMINATION_OFF) && (illuminationFramesLeft > 0);
+}
+
+void ViBe_Model::ExportSamples(vcl_vector<unsigned char>& buffer)
+{
+    buffer.resize(width*height*NUM_SAMPLES*3);
+    unsigned char* dst = &buffer[0];
+    for (int j=0; j<height; j++)
+    {
+        for (int i=0; i<width; i++)
+        {
+            for (int n=0; n<NUM_SAMPLES; n++)
+            {
+                model[i][j]->getSample(n, dst);
+                dst += 3;
+            }
+        }
+    }
+}
+
+bool ViBe_Model::ImportSamples(const vcl_vector<unsigned char>& buffer, int numSamples)
+{
+    if ((int)buffer.size() != width*height*NUM_SAMPLES*3)
+    {
+        return false;
+    }
+    const unsigned char* src = &buffer[0];
+    for (int j=0; j<height; j++)
+    {
+        for (int i=0; i<width; i++)
+        {
+            for (int n=0; n<NUM_SAMPLES; n++)
+            {
+                model[i][j]->FillSample((unsigned char*)src, n);
+                src += 3;
+            }
+            model[i][j]->RebuildFeatures();
+            model[i][j]->setNumSamples(numSamples);
+        }
+    }
+    this->MarkAllDirty();
+    referenceColumns.clear();
+    return true;
+}
+
+void ViBe_Model::ExportPixelSamples(int index, unsigned char* buffer)
+{
+    ViBe_Pixel* pixel = model[index % width][index / width];
+    for (int n=0; n<NUM_SAMPLES; n++)
+    {
+        pixel->getSample(n, buffer);
+        buffer += 3;
+    }
+}
+
+int ViBe_Model::getNumSamples()
+{
+    return model[0][0]->getNumSamples();
+}
+
+int ViBe_Model::getRadius()
+{
+    return radius;
+}
+
+int ViBe_Model::getMinSamplesBackground()
+{
+    return minSamplesBackground;
+}
+
+int ViBe_Model::getWidth()
+{
+    return width;
+}
+
+int ViBe_Model::getHeight()
+{
+    return height;
+}
+
+void ViBe_Model::EnableDirtyTracking(bool enable)
+{
+    trackDirty = enable;
+    tilesAcross = (width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    int tilesDown = (height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    if (enable)
+    {
+        dirtyPixels.assign(width*height, 0);
+        dirtyTiles.assign(tilesAcross*tilesDown, 0);
+    }
+    else
+    {
+        dirtyPixels.clear();
+        dirtyTiles.clear();
+    }
+    numDirty = 0;
+}
+
+bool ViBe_Model::isDirtyTrackingEnabled()
+{
+    return trackDirty;
+}
+
+bool ViBe_Model::isDirty(int x, int y)
+{
+    return trackDirty && dirtyPixels[y*width + x];
+}
+
+bool ViBe_Model::isTileDirty(int tileX, int tileY)
+{
+    return trackDirty && dirtyTiles[tileY*tilesAcross + tileX];
+}
+
+int ViBe_Model::getNumDirty()
+{
+    return numDirty;
+}
+
+void ViBe_Model::MarkDirty(int x, int y)
+{
+    if (!trackDirty)
+    {
+        return;
+    }
+    unsigned char& flag = dirtyPixels[y*width + x];
+    if (!flag)
+    {
+        flag = 1;
+        numDirty++;
+        dirtyTiles[(y / DIRTY_TILE_SIZE)*tilesAcross + x / DIRTY_TILE_SIZE] = 1;
+    }
+}
+
+void ViBe_Model::MarkAllDirty()
+{
+    if (!trackDirty)
+    {
+        return;
+    }
+    dirtyPixels.assign(dirtyPixels.size(), 1);
+    dirtyTiles.assign(dirtyTiles.size(), 1);
+    numDirty = width*height;
+}
+
+int ViBe_Model::CollectDirty(vcl_vector<int>& pixels, bool clear)
+{
+    if (!trackDirty)
+    {
+        return 0;
+    }
+    int found = 0;
+    int tilesDown = dirtyTiles.size() / tilesAcross;
+    for (int tileY=0; tileY<tilesDown; tileY++)
+    {
+        for (int tileX=0; tileX<tilesAcross; tileX++)
+        {
+            unsigned char& tileFlag = dirtyTiles[tileY*tilesAcross + tileX];
+            if (!tileFlag)
+            {
+                continue;
+            }
+            int xEnd = vcl_min((tileX + 1)*DIRTY_TILE_SIZE, width);
+            int yEnd = vcl_min((tileY + 1)*DIRTY_TILE_SIZE, height);
+            for (int y=tileY*DIRTY_TILE_SIZE; y<yEnd; y++)
+            {
+                for (int x=tileX*DIRTY_TILE_SIZE; x<xEnd; x++)
+                {
+                    unsigned char& flag = dirtyPixels[y*width + x];
+                    if (flag)
+                    {
+                        pixels.push_back(y*width + x);
+                        found++;
+                        if (clear)
+                        {
+                            flag = 0;
+                        }
+                    }
+                }
+            }
+            if (clear)
+            {
+                tileFlag = 0;
+            }
+        }
+    }
+    if (clear)
+    {
+        numDirty = 0;
+    }
+    return found;
+}
+
+void ViBe_Model::ClearDirty()
+{
+    if (!trackDirty)
+    {
+        return;
+    }
+    dirtyPixels.assign(dirtyPixels.size(), 0);
+    dirtyTiles.assign(dirtyTiles.size(), 0);
+    numDirty = 0;
+}
+
 void ViBe_Model::PickNeighbour(int x, int y, int& nX, int& nY, vil_image_view <unsigned char>& input)
 {
     while(1)
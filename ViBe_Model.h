@@ -65,10 +65,191 @@ public:
 
     void InitBackground(int numTrainingImages, vcl_vector<vcl_string> filenames);
 
+    /*
+     * Initialise the background from a set of already decoded training images. Training image n is stored as sample n
+     * of every pixel, so the model is filled one image row at a time in parallel
+     * trainingImages - RGB images of size Width x Height, only the first Samples images are used
+     */
+    void InitBackground(vcl_vector< vil_image_view<unsigned char> >& trainingImages);
+
+    /*
+     * Initialise the background from a single frame, each pixel's samples are drawn from its 3x3 neighbourhood, i.e.
+     * to start learning a new scene straight away
+     */
+    void InitBackground(vil_image_view<unsigned char>& frame);
+
+    /*
+     * Exchange the learnt background of this model with that of other, in constant time: the pixel storage is swapped
+     * rather than the samples copied. What depends on the scene (the checkerboard mask, the jitter reference, the
+     * foreground statistics) goes with it, the settings and frame count stay. Both models must be the same size and
+     * have packed matching alike, otherwise it returns false and nothing is swapped. With dirty tracking every pixel is
+     * marked dirty. Used by ViBe_ModelBank to switch between the scenes of a camera
+     */
+    bool SwapScene(ViBe_Model& other);
+
 	void Segment(vil_image_view<unsigned char>& input, vil_image_view<unsigned char>& output);
 
 	void UpdateModel( ViBe_Pixel& background_model, unsigned char* pixel);
 
+    /*
+     * Segment a batch of consecutive frames with several frames in flight at once. Each frame is split into numBands
+     * bands of rows, and band b of a frame may start as soon as bands b-1, b and b+1 of the previous frame (and band
+     * b-1 of its own frame) are done, as model updates only reach the neighbouring rows. Each band draws from its own
+     * random number generator, so the result is the same however the bands are scheduled (it is not the same as
+     * Segment, which draws from one generator in column order). Illumination adaptation, jitter compensation,
+     * checkerboard classification and dirty tracking look beyond a band, with any of these on (see canSegmentBands)
+     * the frames are passed to Segment one at a time
+     * outputs - single plane images the size of the inputs, one per input
+     */
+    void SegmentWavefront(vcl_vector< vil_image_view<unsigned char> >& inputs,
+                          vcl_vector< vil_image_view<unsigned char> >& outputs, int numBands);
+    bool canSegmentBands();
+
+    /*
+     * Row-progressive segmentation, for frames that arrive a group of rows at a time (i.e. as they are decoded). Call
+     * BeginRows, then SegmentRows for each group of rows of the frame from top to bottom, then EndRows. The rows are
+     * classified and update the model in row order as one band of SegmentWavefront would, using the model's random
+     * number generator. Only possible when canSegmentBands() is true
+     * rows -     RGB image of width Width holding the rows from firstRow on
+     * maskRows - single plane image the size of rows, receives their mask
+     */
+    void BeginRows();
+    void SegmentRows(vil_image_view<unsigned char>& rows, vil_image_view<unsigned char>& maskRows, int firstRow);
+    void EndRows();
+
+    /*
+     * Temporal decimation, every frame is classified but the model is only updated on every Interval'th frame. The
+     * update probability on those frames is raised by the same factor (RandomSubsampling / Interval, but never more
+     * often than every pixel), so the model learns at the same rate while being written Interval times less often.
+     * An interval of 1 (the default) updates on every frame
+     */
+    void SetUpdateInterval(int Interval);
+    int getUpdateInterval();
+
+    /*
+     * Change how often a sample is randomly replaced after Init (see RandomSubsampling above)
+     */
+    void SetRandomSubsampling(int RandomSubsampling);
+    int getRandomSubsampling();
+
+    int getFrameCount();                // number of frames segmented (not counting re-classified frames)
+
+    /*
+     * How pixels are matched against samples, DISTANCE_RGB (the default) or DISTANCE_CHROMA (see defines.h)
+     */
+    void SetDistanceMode(int Mode);
+    int getDistanceMode();
+
+    /*
+     * With DISTANCE_RGB, match pixels against only the samples close in intensity, using the order each pixel keeps its
+     * samples in (see ViBe_Pixel::ComparePixelSorted). Gives the same segmentation, with fewer comparisons for larger
+     * sample counts
+     */
+    void SetSortedMatching(bool enable);
+    bool isSortedMatching();
+
+    /*
+     * With DISTANCE_RGB, reject pixels outside the per channel envelope of their samples before comparing any samples
+     * (see ViBe_Pixel::ComparePixel). Gives the same segmentation, but every sample insert has to keep the envelope up
+     * to date, so it only pays off where most pixels are far from their samples. Off by default
+     */
+    void SetEnvelopeRejection(bool enable);
+    bool isEnvelopeRejection();
+
+    /*
+     * With DISTANCE_RGB, keep the samples in one array of cache line aligned blocks of PACKED_BLOCK bytes, a block per
+     * pixel in row order, and match pixels against them with ViBe_Pixel::ComparePixelPacked. Gives the same
+     * segmentation. Enabling moves the pixels' samples into the array and disabling moves them back (see
+     * ViBe_Pixel::AttachPacked), so it can be called before or after training
+     */
+    void SetPackedMatching(bool enable);
+    bool isPackedMatching();
+
+    /*
+     * Approximate matching (DISTANCE_RGB only), each frame a pixel is compared to just Samples of its NUM_SAMPLES
+     * samples, a window that moves on by Samples slots every frame so all samples take their turn. Pixels with
+     * MinSamplesBackground matches in the window are background and pixels with none are foreground. A borderline pixel (some
+     * matches but not enough) falls back to comparing all of its samples. 0 (the default) always compares all samples
+     */
+    void SetApproximateMatching(int Samples);
+    int getApproximateMatching();
+
+    /*
+     * Checkerboard classification, each frame only the pixels of one colour of a checkerboard are classified (and
+     * update the model), alternating every frame. The other pixels are filled in by a vote of their 4 classified
+     * neighbours and their own classification from the previous frame, ties going to the previous frame. The update
+     * probability is doubled so the model learns at the same rate
+     */
+    void SetCheckerboard(bool enable);
+    bool isCheckerboard();
+
+    /*
+     * Apply the settings made to another model after its Init (update rate and interval, matching modes, illumination
+     * and jitter handling), i.e. to set up several models alike. Should be called after Init, and before training
+     */
+    void CopySettings(ViBe_Model& other);
+
+    /*
+     * Number of pixels classified as foreground by the last call to Segment
+     */
+    int getForegroundCount();
+
+    /*
+     * Global illumination change handling. A frame where at least Threshold (0-1) of the pixels are foreground, well
+     * above the running average, and spread over most of an ILLUMINATION_GRID x ILLUMINATION_GRID grid of the image is
+     * taken to be a lighting change rather than motion. Then, depending on Mode:
+     *  ILLUMINATION_FAST_UPDATE - for the next Frames frames every pixel, foreground or not, updates the model every
+     *                             ILLUMINATION_SUBSAMPLING frames, then normal updating resumes
+     *  ILLUMINATION_RESEED -      the model is re-seeded from the current frame, which is then classified again.
+     *                             Detection is suspended for the next Frames frames
+     *  ILLUMINATION_OFF -         no detection (the default)
+     */
+    void SetIlluminationAdaptation(int Mode, double Threshold, int Frames);
+    int getIlluminationChanges();       // number of lighting changes detected
+    bool isAdaptingToIllumination();
+
+    /*
+     * Camera jitter compensation. Before each frame is segmented, its global translation against the background the
+     * model has learnt is estimated (up to MaxShift pixels in x and y) by matching the row and column sums of the
+     * frame against those of the model (taken again every JITTER_REFRESH_FRAMES frames, so they follow the background
+     * as it drifts). The model is then looked up at the shifted location rather than warping the frame. Pixels that have shifted in from outside the model are compared to its border but don't update it.
+     * A MaxShift of 0 (the default) disables compensation
+     */
+    void SetJitterCompensation(int MaxShift);
+    int getJitterX();                   // shift found for the last frame
+    int getJitterY();
+
+    /*
+     * Copy the samples of every pixel to / from a flat buffer, used to checkpoint the model and move it between processes.
+     * The buffer holds Width*Height*NUM_SAMPLES*3 bytes, pixels in row order with the samples of a pixel stored together.
+     * ImportSamples returns false if the buffer doesn't match the size of this model
+     * numSamples - number of valid samples per pixel
+     */
+    void ExportSamples(vcl_vector<unsigned char>& buffer);
+    void ExportPixelSamples(int index, unsigned char* buffer);     // the NUM_SAMPLES*3 bytes of pixel y*Width + x
+    bool ImportSamples(const vcl_vector<unsigned char>& buffer, int numSamples);
+    int getNumSamples();
+    int getRadius();
+    int getMinSamplesBackground();
+
+    int getWidth();
+    int getHeight();
+
+    /*
+     * Optional tracking of which pixels have had samples changed by the update step (or by training / importing), so
+     * that incremental snapshots, background refreshes and change statistics don't need to scan the whole model.
+     * A flag is kept per pixel and per DIRTY_TILE_SIZE x DIRTY_TILE_SIZE tile, so clean tiles are skipped when iterating.
+     * CollectDirty - appends the index (y*Width + x) of each dirty pixel to pixels, tile by tile and in row order within
+     *                a tile, and returns the number appended. If clear is set the flags are cleared as they are read
+     */
+    void EnableDirtyTracking(bool enable);
+    bool isDirtyTrackingEnabled();
+    bool isDirty(int x, int y);
+    bool isTileDirty(int tileX, int tileY);
+    int getNumDirty();
+    int CollectDirty(vcl_vector<int>& pixels, bool clear);
+    void ClearDirty();
+
 protected:
 
     /*
@@ -86,11 +267,73 @@ protected:
      */
 	void CreateModel();
 
+	int ClassifyPixel(ViBe_Pixel* background_model, unsigned char* pixel, int approximateFirst);
+    /*
+     * Per frame update settings, worked out at the start of a frame by NextFrame for Segment and the banded paths alike
+     */
+	struct FrameSettings
+	{
+	    bool updateFrame;
+	    int subsampling;
+	    bool adapting;              // foreground pixels update the model too, after a lighting change
+	    int approximateFirst;
+	};
+	FrameSettings NextFrame();      // settings for the next frame, which is counted unless it is being reclassified
+
+    /*
+     * Segment rows firstRow to lastRow - 1, input and output hold the rows from rowOffset on
+     */
+	int SegmentBand(vil_image_view<unsigned char>& input, vil_image_view<unsigned char>& output, int rowOffset,
+	                int firstRow, int lastRow, const FrameSettings& frame, vnl_random& random);
+
+	void MarkDirty(int x, int y);
+	void MarkAllDirty();
+
+    /*
+     * Have every pixel keep just the sample features the current settings use (see ViBe_Pixel::SetFeatures)
+     */
+	int getPixelFeatures();
+	void UpdatePixelFeatures();
+
+	void DetectIlluminationChange(vil_image_view<unsigned char>& input, vil_image_view<unsigned char>& output,
+	                              int* cellCounts);
+	void Reseed(vil_image_view<unsigned char>& input);
+	void EstimateJitter(vil_image_view<unsigned char>& input);
+
     // Model Parameters
 	int samples;                // number of samples per pixel
 	int radius;                 // target distance when matching pixel
 	int minSamplesBackground;   // number of samples to match to be considered background
 	int randomSubsampling;      // how often to update the samples
+	int updateInterval;         // update the model every updateInterval frames
+	int frameCount;             // number of frames segmented
+	int distanceMode;           // DISTANCE_RGB or DISTANCE_CHROMA
+	bool sortedMatching;        // only compare samples close in intensity
+	bool envelopeRejection;     // reject pixels outside the envelope of their samples without comparing them
+	bool packedMatching;        // compare against the packed sample blocks
+	int approximateSamples;     // samples compared per frame in approximate matching, 0 if off
+	bool checkerboard;          // classify half of the pixels per frame
+	vcl_vector<unsigned char> previousMask;     // last frame's mask in row order, for checkerboard filling
+	unsigned char* packedStorage;   // allocation holding the pixels' sample blocks, NULL if packed matching is off
+	unsigned char* packedSamples;   // first block, aligned to PACKED_ALIGN
+	int lastForegroundCount;    // foreground pixels in the last frame
+
+	int illuminationMode;           // ILLUMINATION_OFF, ILLUMINATION_FAST_UPDATE or ILLUMINATION_RESEED
+	double illuminationThreshold;   // foreground fraction that may indicate a lighting change
+	int illuminationFrames;         // how long to adapt for after a change
+	int illuminationFramesLeft;     // frames of adaptation remaining
+	int illuminationChanges;        // changes detected so far
+	double averageForeground;       // running average of the foreground fraction
+	bool reclassifying;             // classifying a frame again after re-seeding, without updating the model
+
+	int jitterMaxShift;                     // largest shift searched for, 0 if compensation is off
+	int jitterX;                            // shift of the current frame against the model
+	int jitterY;
+	vcl_vector<long> referenceColumns;      // column / row sums of the background, empty until next needed
+	vcl_vector<long> referenceRows;
+	int referenceFrame;                     // frame the sums were taken at, they are refreshed as the background drifts
+	vcl_vector<long> currentColumns;        // column / row sums of the current frame
+	vcl_vector<long> currentRows;
 
 	int width;                  // model width
 	int height;                 // model height
@@ -103,8 +346,22 @@ protected:
 	int numUpdates;             // how many updates bave been performed
 
 	vnl_random* randomNumberGenerator;  // a random number generator to generate values to determine the random sampling
+	vcl_vector<vnl_random*> bandRandom; // one generator per band for SegmentWavefront
+	FrameSettings rowsFrame;            // settings of the frame being segmented by SegmentRows
+	int rowsForegroundCount;            // foreground pixels so far in that frame
+
+	bool trackDirty;                            // whether the dirty flags below are maintained
+	vcl_vector<unsigned char> dirtyPixels;      // one flag per pixel, in row order
+	vcl_vector<unsigned char> dirtyTiles;       // one flag per tile, set if any of its pixels are dirty
+	int tilesAcross;                            // number of tiles in a row
+	int numDirty;                               // number of dirty pixels
 
 private:
+    /// the model owns its pixels, it can't be copied
+	ViBe_Model(const ViBe_Model&);
+	ViBe_Model& operator=(const ViBe_Model&);
+
+	void Free();                // free the pixels and everything else Init and the settings allocated
 };
 
 #endif
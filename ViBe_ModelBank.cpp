@@ -0,0 +1,187 @@
+#include "ViBe_ModelBank.h"
+
+#ifndef _VCL_ALGORITHM_
+#define _VCL_ALGORITHM_
+#include <vcl_algorithm.h>
+#endif
+
+ViBe_ModelBank::ViBe_ModelBank()
+{
+    live = NULL;
+    active = 0;
+    maxScenes = BANK_SCENES;
+    switchDistance = BANK_SWITCH_DISTANCE;
+    matchDistance = BANK_MATCH_DISTANCE;
+    frame = 0;
+    farFrames = 0;
+    switches = 0;
+}
+
+ViBe_ModelBank::~ViBe_ModelBank()
+{
+    for (unsigned k = 0; k < scenes.size(); k++)
+    {
+        delete scenes[k].storage;
+    }
+}
+
+void ViBe_ModelBank::Init(ViBe_Model& Live, int MaxScenes, double SwitchDistance, double MatchDistance)
+{
+    for (unsigned k = 0; k < scenes.size(); k++)
+    {
+        delete scenes[k].storage;
+    }
+    live = &Live;
+    /// there must be room for the scene being left as well as the one being switched to
+    maxScenes = (MaxScenes > 2) ? MaxScenes : 2;
+    switchDistance = SwitchDistance;
+    matchDistance = MatchDistance;
+    frame = 0;
+    farFrames = 0;
+    switches = 0;
+    scenes.assign(1, Scene());
+    scenes[0].storage = NULL;
+    scenes[0].lastActive = 0;
+    active = 0;
+}
+
+int ViBe_ModelBank::getNumScenes()
+{
+    return scenes.size();
+}
+
+int ViBe_ModelBank::getActiveScene()
+{
+    return active;
+}
+
+int ViBe_ModelBank::getSwitches()
+{
+    return switches;
+}
+
+void ViBe_ModelBank::Fingerprint(vil_image_view<unsigned char>& image, vcl_vector<unsigned char>& fingerprint)
+{
+    const int cells = BANK_THUMBNAIL_WIDTH*BANK_THUMBNAIL_HEIGHT;
+    fingerprint.resize(2*cells);
+    int ni = image.ni();
+    int nj = image.nj();
+    /// frames decoded as luma only have no colour, their saturation is 0
+    int greenPlane = (image.nplanes() >= 3) ? 1 : 0;
+    int bluePlane = (image.nplanes() >= 3) ? 2 : 0;
+    for (int cy = 0; cy < BANK_THUMBNAIL_HEIGHT; cy++)
+    {
+        for (int cx = 0; cx < BANK_THUMBNAIL_WIDTH; cx++)
+        {
+            /// every other pixel of every other row is plenty for a mean
+            long luma = 0; long saturation = 0; long count = 0;
+            for (int j = (cy*nj) / BANK_THUMBNAIL_HEIGHT; j < ((cy + 1)*nj) / BANK_THUMBNAIL_HEIGHT; j += 2)
+            {
+                for (int i = (cx*ni) / BANK_THUMBNAIL_WIDTH; i < ((cx + 1)*ni) / BANK_THUMBNAIL_WIDTH; i += 2)
+                {
+                    int r = image(i,j,0); int g = image(i,j,greenPlane); int b = image(i,j,bluePlane);
+                    luma += 77*r + 150*g + 29*b;
+                    saturation += ((r > g) ? r - g : g - r) + ((b > g) ? b - g : g - b);
+                    count++;
+                }
+            }
+            int cell = cy*BANK_THUMBNAIL_WIDTH + cx;
+            fingerprint[cell] = (count > 0) ? (unsigned char)(luma / (256*count)) : 0;
+            fingerprint[cells + cell] = (count > 0) ? (unsigned char)vcl_min(saturation / count, 255L) : 0;
+        }
+    }
+}
+
+double ViBe_ModelBank::Distance(const vcl_vector<unsigned char>& a, const vcl_vector<unsigned char>& b)
+{
+    long total = 0;
+    for (unsigned k = 0; k < a.size(); k++)
+    {
+        total += (a[k] > b[k]) ? a[k] - b[k] : b[k] - a[k];
+    }
+    return a.empty() ? 0 : (double)total / a.size();
+}
+
+int ViBe_ModelBank::Update(vil_image_view<unsigned char>& image)
+{
+    frame++;
+    Fingerprint(image, current);
+    if (scenes[active].fingerprint.empty())
+    {
+        scenes[active].fingerprint = current;
+    }
+
+    if (Distance(current, scenes[active].fingerprint) <= switchDistance)
+    {
+        /// follow slow changes of the scene, a 1/8 step towards the frame
+        farFrames = 0;
+        scenes[active].lastActive = frame;
+        vcl_vector<unsigned char>& fingerprint = scenes[active].fingerprint;
+        for (unsigned k = 0; k < fingerprint.size(); k++)
+        {
+            fingerprint[k] = (unsigned char)((7*fingerprint[k] + current[k] + 4) / 8);
+        }
+        return BANK_SAME;
+    }
+    /// a large object passing close to the camera only fills the frame for a moment
+    if (++farFrames < BANK_CONFIRM_FRAMES)
+    {
+        return BANK_SAME;
+    }
+    farFrames = 0;
+    switches++;
+
+    int closest = -1;
+    double closestDistance = 0;
+    for (int k = 0; k < (int)scenes.size(); k++)
+    {
+        double distance = Distance(current, scenes[k].fingerprint);
+        if ((k != active) && (distance <= matchDistance) && ((closest < 0) || (distance < closestDistance)))
+        {
+            closest = k;
+            closestDistance = distance;
+        }
+    }
+    if (closest >= 0)
+    {
+        /// the stored background and the one being left change places
+        live->SwapScene(*scenes[closest].storage);
+        scenes[active].storage = scenes[closest].storage;
+        scenes[closest].storage = NULL;
+        scenes[closest].lastActive = frame;
+        active = closest;
+        return BANK_STORED;
+    }
+
+    /// a new scene, in new storage until the bank is full, then in that of the least recently used scene
+    int slot = -1;
+    ViBe_Model* storage = NULL;
+    if ((int)scenes.size() < maxScenes)
+    {
+        storage = new ViBe_Model;
+        storage->Init(NUM_SAMPLES, live->getRadius(), live->getMinSamplesBackground(), live->getRandomSubsampling(),
+                      live->getWidth(), live->getHeight());
+        storage->CopySettings(*live);
+        slot = scenes.size();
+        scenes.push_back(Scene());
+    }
+    else
+    {
+        for (int k = 0; k < (int)scenes.size(); k++)
+        {
+            if ((k != active) && ((slot < 0) || (scenes[k].lastActive < scenes[slot].lastActive)))
+            {
+                slot = k;
+            }
+        }
+        storage = scenes[slot].storage;
+    }
+    live->SwapScene(*storage);
+    scenes[active].storage = storage;
+    scenes[slot].storage = NULL;
+    scenes[slot].fingerprint = current;
+    scenes[slot].lastActive = frame;
+    active = slot;
+    live->InitBackground(image);
+    return BANK_NEW;
+}
@@ -0,0 +1,89 @@
+#ifndef __VIBE_MODEL_BANK_H__
+#define __VIBE_MODEL_BANK_H__
+
+#include "ViBe_Model.h"
+
+#include <vil/vil_image_view.h>
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+#define BANK_SCENES 4               // scenes kept per camera, including the one being segmented
+#define BANK_THUMBNAIL_WIDTH 16     // cells of the fingerprint thumbnail
+#define BANK_THUMBNAIL_HEIGHT 12
+#define BANK_SWITCH_DISTANCE 20     // fingerprint distance from the current scene that is a scene switch
+#define BANK_MATCH_DISTANCE 12      // fingerprint distance to a stored scene close enough to swap it in
+#define BANK_CONFIRM_FRAMES 2       // frames in a row that must be far from the current scene before switching
+
+/// results of ViBe_ModelBank::Update
+#define BANK_SAME 0                 // still the same scene
+#define BANK_STORED 1               // switched to a stored scene
+#define BANK_NEW 2                  // switched to a scene not seen before (or evicted), learning it from the frame
+
+/*
+ * Bank of the backgrounds learnt for the scenes a camera switches between, i.e. the presets of a PTZ camera, or day
+ * and night when the IR cut filter toggles. Without it ViBe floods with foreground after a switch until it has
+ * relearnt the scene, with it the background of the closest stored scene is swapped into the model in constant time.
+ *
+ * Each scene is recognised by a fingerprint of the frame, a thumbnail of the mean luma and colour saturation of
+ * BANK_THUMBNAIL_WIDTH x BANK_THUMBNAIL_HEIGHT cells, compared by mean absolute difference (0 - 255). The current
+ * scene's fingerprint follows slow changes such as the light fading. When frames stay more than SwitchDistance from it
+ * for BANK_CONFIRM_FRAMES frames, the stored scene closest to the frame (within MatchDistance) is swapped in with
+ * ViBe_Model::SwapScene. If there is none, a new scene is started and learnt from the frame, its storage taken from
+ * the least recently used scene once MaxScenes are stored.
+ *
+ * Each stored scene holds a full model's worth of samples, and a scene's storage is only allocated (as a ViBe_Model
+ * with the same settings as the live model) the first time it is needed.
+ */
+class ViBe_ModelBank
+{
+public:
+    ViBe_ModelBank();
+    ~ViBe_ModelBank();
+
+    /*
+     * live - the (trained) model that segments the camera's frames, the scenes are swapped in and out of it. The scene
+     *        it has learnt is taken to be that of the first frame passed to Update
+     */
+    void Init(ViBe_Model& live, int MaxScenes = BANK_SCENES, double SwitchDistance = BANK_SWITCH_DISTANCE,
+              double MatchDistance = BANK_MATCH_DISTANCE);
+
+    /*
+     * Look at a frame before it is segmented, switching the live model's scene if the frame shows another one.
+     * Returns BANK_SAME, BANK_STORED or BANK_NEW
+     */
+    int Update(vil_image_view<unsigned char>& frame);
+
+    int getNumScenes();
+    int getActiveScene();               // index of the scene the live model holds
+    int getSwitches();                  // scene switches so far
+
+    static void Fingerprint(vil_image_view<unsigned char>& frame, vcl_vector<unsigned char>& fingerprint);
+    static double Distance(const vcl_vector<unsigned char>& a, const vcl_vector<unsigned char>& b);
+
+private:
+    ViBe_ModelBank(const ViBe_ModelBank&);
+    ViBe_ModelBank& operator=(const ViBe_ModelBank&);
+
+    struct Scene
+    {
+        vcl_vector<unsigned char> fingerprint;
+        ViBe_Model* storage;            // holds the scene's background while it isn't active, NULL for the active scene
+        int lastActive;                 // frame the scene was last active, to evict the least recently used
+    };
+
+    ViBe_Model* live;
+    vcl_vector<Scene> scenes;
+    int active;
+    int maxScenes;
+    double switchDistance;
+    double matchDistance;
+    int frame;                          // frames seen
+    int farFrames;                      // frames in a row far from the active scene
+    int switches;
+    vcl_vector<unsigned char> current;  // fingerprint of the frame being looked at
+};
+
+#endif
@@ -14,6 +14,10 @@
 #include <vcl_string.h>
 #endif
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #ifndef _VCL_IOSTREAM_
 #define _VCL_IOSTREAM_
 #include <vcl_iostream.h>
@@ -22,13 +26,41 @@
 ViBe_Pixel::ViBe_Pixel()
 {
     numSamples = 0;
-    samples = new unsigned char*[NUM_SAMPLES];
-    for (int i=0; i<NUM_SAMPLES; i++)
+    /// lane padding is never compared, but is zeroed so the block is fully defined
+    samples = new unsigned char[PACKED_BLOCK];
+    for (int n=0; n<PACKED_BLOCK; n++)
+    {
+        samples[n] = 0;
+    }
+    attached = false;
+    /// every slot is compared by ComparePixel, so the envelope covers the empty (zero) ones too
+    envelope = false;
+    for (int c=0; c<3; c++)
     {
-        samples[i] = new unsigned char[3];
+        envelopeMin[c] = 0;
+        envelopeMax[c] = 0;
     }
+    intensity = NULL;
+    brightnessLow = NULL;
+    brightnessHigh = NULL;
+    chromaticity = NULL;
+    order = NULL;
     //vcl_cout << &numSamples << vcl_endl;
 }
+ViBe_Pixel::~ViBe_Pixel()
+{
+    /// an attached block belongs to the model
+    if (!attached)
+    {
+        delete [] samples;
+    }
+    delete [] intensity;
+    delete [] brightnessLow;
+    delete [] brightnessHigh;
+    delete [] chromaticity;
+    delete [] order;
+}
+
 void ViBe_Pixel::debugString()
 {
     vcl_cout << "You have access to the ViBe_Pixel!" << vcl_endl;
@@ -36,9 +68,65 @@ void ViBe_Pixel::debugString()
 
 void ViBe_Pixel::addSample(unsigned char* pixel, int index)
 {
-    samples[index][0] = pixel[0];
-    samples[index][1] = pixel[1];
-    samples[index][2] = pixel[2];
+    if (!envelope)
+    {
+        this->FillSample(pixel, index);
+        this->UpdateFeatures(index);
+        return;
+    }
+    /// the envelope only needs rebuilding if the sample being replaced was on its boundary, otherwise it just grows
+    bool rebuild = false;
+    for (int c=0; c<3; c++)
+    {
+        unsigned char old = samples[c*PACKED_LANE + index];
+        if (((old == envelopeMin[c]) && (pixel[c] > old)) || ((old == envelopeMax[c]) && (pixel[c] < old)))
+        {
+            rebuild = true;
+        }
+    }
+    this->FillSample(pixel, index);
+    this->UpdateFeatures(index);
+    if (rebuild)
+    {
+        this->UpdateEnvelope();
+    }
+    else
+    {
+        for (int c=0; c<3; c++)
+        {
+            if (pixel[c] < envelopeMin[c])
+            {
+                envelopeMin[c] = pixel[c];
+            }
+            if (pixel[c] > envelopeMax[c])
+            {
+                envelopeMax[c] = pixel[c];
+            }
+        }
+    }
+}
+
+void ViBe_Pixel::FillSample(unsigned char* pixel, int index)
+{
+    samples[index] = pixel[0];
+    samples[PACKED_LANE + index] = pixel[1];
+    samples[2*PACKED_LANE + index] = pixel[2];
+}
+
+void ViBe_Pixel::RebuildFeatures()
+{
+    for (int index=0; index<NUM_SAMPLES; index++)
+    {
+        this->ComputeFeatures(index);
+    }
+    if (order != NULL)
+    {
+        this->SortOrder();
+    }
+    if (envelope)
+    {
+        this->UpdateEnvelope();
+    }
 }
 
 void ViBe_Pixel::addSample(unsigned char* pixel)
@@ -51,15 +139,185 @@ void ViBe_Pixel::addSample(unsigned char* pixel)
     if (numSamples < 20)
     {
     numSamples++;
-    samples[numSamples-1][0] = pixel[0];
-    samples[numSamples-1][1] = pixel[1];
-    samples[numSamples-1][2] = pixel[2];
+    this->addSample(pixel, numSamples-1);
+    }
+}
+
+void ViBe_Pixel::UpdateFeatures(int index)
+{
+    this->ComputeFeatures(index);
+    if (order != NULL)
+    {
+        this->UpdateOrder(index);
+    }
+}
+
+void ViBe_Pixel::ComputeFeatures(int index)
+{
+    if (intensity == NULL)
+    {
+        return;
+    }
+    unsigned char sample[3];
+    this->getSample(index, sample);
+    int sum = sample[0] + sample[1] + sample[2];
+    intensity[index] = sum;
+    if (chromaticity == NULL)
+    {
+        return;
+    }
+
+    int low = (sum * BRIGHTNESS_LOW) >> 8;
+    int high = (sum * BRIGHTNESS_HIGH) >> 8;
+    if (low > sum - BRIGHTNESS_MIN_RANGE)
+    {
+        low = sum - BRIGHTNESS_MIN_RANGE;
+    }
+    if (high < sum + BRIGHTNESS_MIN_RANGE)
+    {
+        high = sum + BRIGHTNESS_MIN_RANGE;
+    }
+    brightnessLow[index] = (low > 0) ? low : 0;
+    brightnessHigh[index] = high;
+
+    if (sum > 0)
+    {
+        chromaticity[2*index] = (255 * sample[0]) / sum;
+        chromaticity[2*index+1] = (255 * sample[1]) / sum;
+    }
+    else
+    {
+        chromaticity[2*index] = 85;
+        chromaticity[2*index+1] = 85;
+    }
+}
+
+void ViBe_Pixel::SetFeatures(int Features)
+{
+    bool chroma = (Features & FEATURE_CHROMA) != 0;
+    bool sorted = (Features & FEATURE_ORDER) != 0;
+    bool rebuild = (chroma && (chromaticity == NULL)) || (sorted && (order == NULL)) ||
+                   ((Features & FEATURE_ENVELOPE) && !envelope);
+    envelope = (Features & FEATURE_ENVELOPE) != 0;
+
+    if (!chroma && (chromaticity != NULL))
+    {
+        delete [] brightnessLow;
+        delete [] brightnessHigh;
+        delete [] chromaticity;
+        brightnessLow = NULL;
+        brightnessHigh = NULL;
+        chromaticity = NULL;
+    }
+    if (!sorted && (order != NULL))
+    {
+        delete [] order;
+        order = NULL;
+    }
+    /// the intensity of each sample is used by both
+    if (!chroma && !sorted)
+    {
+        delete [] intensity;
+        intensity = NULL;
+    }
+    else if (intensity == NULL)
+    {
+        intensity = new unsigned short[NUM_SAMPLES];
+    }
+    if (chroma && (chromaticity == NULL))
+    {
+        brightnessLow = new unsigned short[NUM_SAMPLES];
+        brightnessHigh = new unsigned short[NUM_SAMPLES];
+        chromaticity = new unsigned char[NUM_SAMPLES*2];
+    }
+    if (sorted && (order == NULL))
+    {
+        order = new unsigned char[NUM_SAMPLES];
+    }
+    /// new features are computed from the current samples in one pass, from then on addSample keeps them up to date
+    if (rebuild)
+    {
+        this->RebuildFeatures();
+    }
+}
+
+void ViBe_Pixel::SortOrder()
+{
+    /// insertion sort, there are only NUM_SAMPLES slots
+    for (int index=0; index<NUM_SAMPLES; index++)
+    {
+        int sum = intensity[index];
+        int position = index;
+        while ((position > 0) && (intensity[order[position-1]] > sum))
+        {
+            order[position] = order[position-1];
+            position--;
+        }
+        order[position] = index;
+    }
+}
+
+void ViBe_Pixel::UpdateOrder(int index)
+{
+    /// the rest of the order is still sorted, so the changed slot only has to be moved up or down to its place
+    int position = 0;
+    while (order[position] != index)
+    {
+        position++;
+    }
+    int sum = intensity[index];
+    while ((position > 0) && (intensity[order[position-1]] > sum))
+    {
+        order[position] = order[position-1];
+        position--;
+    }
+    while ((position < NUM_SAMPLES-1) && (intensity[order[position+1]] < sum))
+    {
+        order[position] = order[position+1];
+        position++;
+    }
+    order[position] = index;
+}
+
+void ViBe_Pixel::UpdateEnvelope()
+{
+    for (int c=0; c<3; c++)
+    {
+        unsigned char* lane = samples + c*PACKED_LANE;
+        envelopeMin[c] = lane[0];
+        envelopeMax[c] = lane[0];
+        for (int index=1; index<NUM_SAMPLES; index++)
+        {
+            if (lane[index] < envelopeMin[c])
+            {
+                envelopeMin[c] = lane[index];
+            }
+            if (lane[index] > envelopeMax[c])
+            {
+                envelopeMax[c] = lane[index];
+            }
+        }
+    }
+}
+
+bool ViBe_Pixel::isOutsideEnvelope(unsigned char* pixel, int radius)
+{
+    /// a channel difference of radius or more on its own puts every sample at least radius away
+    for (int c=0; c<3; c++)
+    {
+        if ((pixel[c] + radius <= envelopeMin[c]) || (pixel[c] >= envelopeMax[c] + radius))
+        {
+            return true;
+        }
     }
+    return false;
 }
 
-unsigned char** ViBe_Pixel::getSamples()
+void ViBe_Pixel::getSample(int index, unsigned char* pixel)
 {
-    return samples;
+    pixel[0] = samples[index];
+    pixel[1] = samples[PACKED_LANE + index];
+    pixel[2] = samples[2*PACKED_LANE + index];
 }
 
 int ViBe_Pixel::getNumSamples()
@@ -67,6 +325,11 @@ int ViBe_Pixel::getNumSamples()
     return numSamples;
 }
 
+void ViBe_Pixel::setNumSamples(int count)
+{
+    numSamples = count;
+}
+
 int ViBe_Pixel::euclideanDist(unsigned char* pixel, unsigned char* background_sample)
 {
     int distance = sqrt( (background_sample[0]-pixel[0])*(background_sample[0]-pixel[0]) +
@@ -76,17 +339,187 @@ int ViBe_Pixel::euclideanDist(unsigned char* pixel, unsigned char* background_sa
 }
 
 
-int ViBe_Pixel::ComparePixel(ViBe_Pixel& background_model, unsigned char* pixel)
+int ViBe_Pixel::ComparePixel(ViBe_Pixel& background_model, unsigned char* pixel, int radius, int minSamples)
 {
     int count=0; int index = 0; int dist = 0;
-    while ((count < MINSAMPLES) && (index < NUM_SAMPLES) )
+    if (background_model.envelope && background_model.isOutsideEnvelope(pixel, radius))
+    {
+        return 0;
+    }
+    while ((count < minSamples) && (index < NUM_SAMPLES) )
+    {
+        unsigned char sample[3];
+        background_model.getSample(index, sample);
+        dist = ViBe_Pixel::euclideanDist( sample, pixel);
+        if (dist < radius)
+        {
+            count++;
+        }
+        index++;
+    }
+    return count;
+}
+
+int ViBe_Pixel::ComparePixelSorted(unsigned char* pixel, int radius, int minSamples)
+{
+    if (envelope && this->isOutsideEnvelope(pixel, radius))
+    {
+        return 0;
+    }
+    /// largest intensity difference d with d*d < 3*radius*radius, only worked out per call for other radii
+    static const int defaultMaxDiff = (int)sqrt(3.0*RADIUS*RADIUS - 1);
+    int maxDiff = (radius == RADIUS) ? defaultMaxDiff : (int)sqrt(3.0*radius*radius - 1);
+    int sum = pixel[0] + pixel[1] + pixel[2];
+
+    /// first sample in the order with intensity >= sum - maxDiff
+    int low = 0; int high = NUM_SAMPLES;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (intensity[order[middle]] < sum - maxDiff)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    int count = 0;
+    for (int position = low; (position < NUM_SAMPLES) && (count < minSamples); position++)
+    {
+        int index = order[position];
+        if (intensity[index] > sum + maxDiff)
+        {
+            break;
+        }
+        int dr = samples[index] - pixel[0];
+        int dg = samples[PACKED_LANE + index] - pixel[1];
+        int db = samples[2*PACKED_LANE + index] - pixel[2];
+        if (dr*dr + dg*dg + db*db < radius*radius)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+int ViBe_Pixel::ComparePixelSubset(unsigned char* pixel, int first, int numSamples, int radius, int minSamples)
+{
+    if (envelope && this->isOutsideEnvelope(pixel, radius))
+    {
+        return 0;
+    }
+    int count = 0;
+    int index = first;
+    for (int n=0; (n < numSamples) && (count < minSamples); n++)
+    {
+        int dr = samples[index] - pixel[0];
+        int dg = samples[PACKED_LANE + index] - pixel[1];
+        int db = samples[2*PACKED_LANE + index] - pixel[2];
+        if (dr*dr + dg*dg + db*db < radius*radius)
+        {
+            count++;
+        }
+        index = (index + 1 < NUM_SAMPLES) ? index + 1 : 0;
+    }
+    return count;
+}
+
+void ViBe_Pixel::AttachPacked(unsigned char* block)
+{
+    if ((block == NULL) && !attached)
+    {
+        return;
+    }
+    /// the samples move to the given block, or back to a block of the pixel's own
+    unsigned char* storage = (block != NULL) ? block : new unsigned char[PACKED_BLOCK];
+    for (int n=0; n<PACKED_BLOCK; n++)
+    {
+        storage[n] = samples[n];
+    }
+    if (!attached)
     {
-        unsigned char** samples = background_model.getSamples();
-        dist = ViBe_Pixel::euclideanDist( samples[index], pixel);
-        if (dist < RADIUS)
+        delete [] samples;
+    }
+    samples = storage;
+    attached = (block != NULL);
+}
+
+int ViBe_Pixel::ComparePixelPacked(unsigned char* pixel, int radius, int minSamples)
+{
+    if (envelope && this->isOutsideEnvelope(pixel, radius))
+    {
+        return 0;
+    }
+    int count = 0;
+#ifdef __AVX2__
+    /// squared distances of 8 samples at a time in 32 bit lanes, one match bit per sample
+    __m256i pr = _mm256_set1_epi32(pixel[0]);
+    __m256i pg = _mm256_set1_epi32(pixel[1]);
+    __m256i pb = _mm256_set1_epi32(pixel[2]);
+    __m256i radius2 = _mm256_set1_epi32(radius*radius);
+    for (int n=0; (n < NUM_SAMPLES) && (count < minSamples); n+=8)
+    {
+        __m256i dr = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(samples + n))), pr);
+        __m256i dg = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(samples + PACKED_LANE + n))), pg);
+        __m256i db = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(samples + 2*PACKED_LANE + n))), pb);
+        __m256i dist = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(dr, dr), _mm256_mullo_epi32(dg, dg)),
+                                        _mm256_mullo_epi32(db, db));
+        unsigned int matches = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(radius2, dist)));
+        if (NUM_SAMPLES - n < 8)
+        {
+            /// past the end of the lane is the next lane, or padding
+            matches &= (1u << (NUM_SAMPLES - n)) - 1;
+        }
+        count += __builtin_popcount(matches);
+    }
+#else
+    for (int n=0; (n < NUM_SAMPLES) && (count < minSamples); n++)
+    {
+        int dr = samples[n] - pixel[0];
+        int dg = samples[PACKED_LANE + n] - pixel[1];
+        int db = samples[2*PACKED_LANE + n] - pixel[2];
+        if (dr*dr + dg*dg + db*db < radius*radius)
         {
             count++;
         }
+    }
+#endif
+    return (count < minSamples) ? count : minSamples;
+}
+
+int ViBe_Pixel::ComparePixelChroma(unsigned char* pixel, int minSamples)
+{
+    int sum = pixel[0] + pixel[1] + pixel[2];
+    int r = 85;
+    int g = 85;
+    if (sum > 0)
+    {
+        r = (255 * pixel[0]) / sum;
+        g = (255 * pixel[1]) / sum;
+    }
+
+    int count=0; int index = 0;
+    while ((count < minSamples) && (index < NUM_SAMPLES) )
+    {
+        if ((sum >= brightnessLow[index]) && (sum <= brightnessHigh[index]))
+        {
+            if (intensity[index] < CHROMA_MIN_INTENSITY)
+            {
+                count++;
+            }
+            else
+            {
+                int dr = r - chromaticity[2*index];
+                int dg = g - chromaticity[2*index+1];
+                if ((dr < 0 ? -dr : dr) + (dg < 0 ? -dg : dg) <= CHROMA_RADIUS)
+                {
+                    count++;
+                }
+            }
+        }
         index++;
     }
     return count;
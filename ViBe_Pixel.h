@@ -25,17 +25,82 @@ class ViBe_Pixel
 {
 public:
     ViBe_Pixel();
+    ~ViBe_Pixel();
     void addSample(unsigned char* pixel, int index);
     void addSample(unsigned char* pixel);
-    unsigned char** getSamples();
+    /*
+     * Bulk filling, FillSample only stores the sample, leaving its features stale, so a pixel whose samples are all
+     * replaced at once doesn't update them on every insert. Call RebuildFeatures once the samples are in
+     */
+    void FillSample(unsigned char* pixel, int index);
+    void RebuildFeatures();
+    void getSample(int index, unsigned char* pixel);    // copies sample index's r, g and b to pixel
     static int euclideanDist(unsigned char* pixel, unsigned char* background_sample);
     void debugString();
     int getNumSamples();
-    int ComparePixel(ViBe_Pixel& background_model, unsigned char* pixel);
+    void setNumSamples(int count);
+    /*
+     * Count matching samples (up to minSamples) using the RGB distance, a sample matches if it is less than radius
+     * away. With FEATURE_ENVELOPE, a pixel that is radius or more away from the envelope of the samples in any channel
+     * can't match any of them, so it returns 0 without comparing samples (as do the other RGB comparisons)
+     */
+    int ComparePixel(ViBe_Pixel& background_model, unsigned char* pixel, int radius = RADIUS,
+                     int minSamples = MINSAMPLES);
+    bool isOutsideEnvelope(unsigned char* pixel, int radius = RADIUS);
+    /*
+     * Same result as ComparePixel, but only samples whose intensity (r+g+b) could be within radius of the pixel are
+     * compared. The sum of the channel differences is at most sqrt(3) times their euclidean length, so a match needs
+     * (sum difference)^2 < 3*radius^2. Those samples are found by a binary search of the intensity order, so it
+     * needs FEATURE_ORDER
+     */
+    int ComparePixelSorted(unsigned char* pixel, int radius = RADIUS, int minSamples = MINSAMPLES);
+    /*
+     * Count matching samples (up to minSamples) using the RGB distance, among only numSamples samples starting at
+     * slot first (wrapping around)
+     */
+    int ComparePixelSubset(unsigned char* pixel, int first, int numSamples, int radius = RADIUS,
+                           int minSamples = MINSAMPLES);
+    /*
+     * The samples are kept in a block of PACKED_BLOCK bytes laid out as an r, g and b lane of PACKED_LANE bytes each,
+     * with sample n at offset n of each lane. The block is the pixel's own, unless one is attached (i.e. a slot of the
+     * model's cache line aligned array), in which case the samples are moved into it and it is their only copy until
+     * it is detached with NULL. ComparePixelPacked gives the same result as ComparePixel, testing 8 samples per
+     * instruction when built with AVX2 (-mavx2), otherwise one at a time
+     */
+    void AttachPacked(unsigned char* block);
+    int ComparePixelPacked(unsigned char* pixel, int radius = RADIUS, int minSamples = MINSAMPLES);
+    /*
+     * Count matching samples (up to minSamples) using chromaticity and brightness (DISTANCE_CHROMA), against the
+     * features precomputed for each sample when it was added. Needs FEATURE_CHROMA
+     */
+    int ComparePixelChroma(unsigned char* pixel, int minSamples = MINSAMPLES);
+    /*
+     * Which of the optional sample features (FEATURE_ bits) to keep up to date. Features being turned on are allocated
+     * and computed from the current samples, features being turned off are freed
+     */
+    void SetFeatures(int Features);
 protected:
+    void UpdateFeatures(int index);
+    void ComputeFeatures(int index);    // UpdateFeatures without the order
+    void UpdateEnvelope();
+    void UpdateOrder(int index);
+    void SortOrder();
 private:
-    unsigned char** samples;
+    ViBe_Pixel(const ViBe_Pixel&);
+    ViBe_Pixel& operator=(const ViBe_Pixel&);
+
+    unsigned char* samples;         // the r, g and b lanes, see AttachPacked
+    bool attached;                  // whether samples is a block attached by the model rather than the pixel's own
     int numSamples;
+    // features of each sample, computed when it is added
+    unsigned short* intensity;      // r+g+b, NULL without FEATURE_CHROMA or FEATURE_ORDER
+    unsigned short* brightnessLow;  // range of r+g+b that a matching pixel may have, NULL without FEATURE_CHROMA
+    unsigned short* brightnessHigh;
+    unsigned char* chromaticity;    // normalised r and g, 2 per sample, NULL without FEATURE_CHROMA
+    unsigned char* order;           // sample slots sorted by increasing intensity, NULL without FEATURE_ORDER
+    bool envelope;                  // whether the envelope is kept, FEATURE_ENVELOPE
+    unsigned char envelopeMin[3];   // per channel min / max over all NUM_SAMPLES sample slots
+    unsigned char envelopeMax[3];
 };
 
 #endif
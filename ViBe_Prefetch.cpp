@@ -0,0 +1,193 @@
+#include "ViBe_Prefetch.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#define O_BINARY 0
+#endif
+
+/// buffers are only grown, with half again of headroom so that files a little larger than those seen so far fit
+static void GrowBuffer(vcl_vector<unsigned char>& buffer, unsigned long size)
+{
+    if (buffer.size() < size)
+    {
+        buffer.resize(size + size/2);
+    }
+}
+
+/// read a whole file with unbuffered I/O into buffer, returns the bytes read
+static unsigned long ReadWholeFile(const char* filename, vcl_vector<unsigned char>& buffer)
+{
+    int file = open(filename, O_RDONLY | O_BINARY);
+    if (file < 0)
+    {
+        return 0;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+        close(file);
+        return 0;
+    }
+    unsigned long fileSize = info.st_size;
+    GrowBuffer(buffer, fileSize);
+    unsigned long done = 0;
+    while (done < fileSize)
+    {
+        int got = read(file, &buffer[done], fileSize - done);
+        if (got <= 0)
+        {
+            break;
+        }
+        done += got;
+    }
+    close(file);
+    return done;
+}
+
+ViBe_FramePrefetcher::ViBe_FramePrefetcher()
+{
+    filenames = NULL;
+    depth = PREFETCH_DEPTH;
+    next = 0;
+    largest = 0;
+    running = false;
+    numBatches = 0;
+    readBatches = 0;
+    allowedBatches = 0;
+    stopping = false;
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&changed, NULL);
+}
+
+ViBe_FramePrefetcher::~ViBe_FramePrefetcher()
+{
+    this->Stop();
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&lock);
+}
+
+void ViBe_FramePrefetcher::Start(const vcl_vector<vcl_string>& Filenames, int Depth)
+{
+    this->Stop();
+    filenames = &Filenames;
+    depth = (Depth > 0) ? Depth : 1;
+    next = 0;
+    slots.resize(2*depth);
+    for (unsigned k = 0; k < slots.size(); k++)
+    {
+        slots[k].size = 0;
+    }
+    numBatches = ((int)filenames->size() + depth - 1) / depth;
+    readBatches = 0;
+    allowedBatches = 2;
+    stopping = false;
+    running = (numBatches > 0) && (pthread_create(&reader, NULL, ReaderMain, this) == 0);
+}
+
+void ViBe_FramePrefetcher::Stop()
+{
+    if (!running)
+    {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&changed);
+    pthread_mutex_unlock(&lock);
+    pthread_join(reader, NULL);
+    running = false;
+}
+
+int ViBe_FramePrefetcher::Next(const unsigned char*& data, unsigned long& size)
+{
+    if ((filenames == NULL) || (next >= (int)filenames->size()))
+    {
+        return -1;
+    }
+    int frame = next++;
+    int index = frame % (2*depth);
+
+    if (frame % depth == 0)
+    {
+        int batch = frame / depth;
+        if (running)
+        {
+            /// the decoder is done with batch-1, so the reader can go on to batch+1 in its slots, and this batch is
+            /// waited for (only one of the two threads can be waiting at once, so a single condition does)
+            pthread_mutex_lock(&lock);
+            allowedBatches = batch + 2;
+            pthread_cond_signal(&changed);
+            while (readBatches <= batch)
+            {
+                pthread_cond_wait(&changed, &lock);
+            }
+            pthread_mutex_unlock(&lock);
+        }
+        else
+        {
+            this->ReadBatch(batch);
+        }
+    }
+
+    data = slots[index].buffer.empty() ? NULL : &slots[index].buffer[0];
+    size = slots[index].size;
+    return frame;
+}
+
+void* ViBe_FramePrefetcher::ReaderMain(void* prefetcher)
+{
+    ((ViBe_FramePrefetcher*)prefetcher)->ReadAhead();
+    return NULL;
+}
+
+void ViBe_FramePrefetcher::ReadAhead()
+{
+    pthread_mutex_lock(&lock);
+    while (!stopping && (readBatches < numBatches))
+    {
+        if (readBatches >= allowedBatches)
+        {
+            pthread_cond_wait(&changed, &lock);
+            continue;
+        }
+        int batch = readBatches;
+        pthread_mutex_unlock(&lock);
+        this->ReadBatch(batch);
+        pthread_mutex_lock(&lock);
+        readBatches++;
+        pthread_cond_signal(&changed);
+    }
+    pthread_mutex_unlock(&lock);
+}
+void ViBe_FramePrefetcher::ReadBatch(int batch)
+{
+    int first = batch*depth;
+    int last = ((int)filenames->size() < first + depth) ? (int)filenames->size() : first + depth;
+
+    /// every slot is grown to the largest file seen so far, so there are no more allocations once the largest file
+    /// has been read rather than once every slot has seen a large file
+    for (int f = first; f < last; f++)
+    {
+        GrowBuffer(slots[f % (2*depth)].buffer, largest);
+    }
+
+    /// the files of a batch are read at once, so their latencies overlap
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int f = first; f < last; f++)
+    {
+        Slot& slot = slots[f % (2*depth)];
+        slot.size = ReadWholeFile((*filenames)[f].c_str(), slot.buffer);
+    }
+
+    for (int f = first; f < last; f++)
+    {
+        if (slots[f % (2*depth)].size > largest)
+        {
+            largest = slots[f % (2*depth)].size;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef __VIBE_PREFETCH_H__
+#define __VIBE_PREFETCH_H__
+
+#ifndef _VCL_STRING_
+#define _VCL_STRING_
+#include <vcl_string.h>
+#endif
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+#include <pthread.h>
+
+#define PREFETCH_DEPTH 16           // frames read per batch
+
+/*
+ * Reads the files of a list of frames ahead of the decoder, in batches of Depth frames, into pooled buffers that
+ * only ever grow, so the decoder can take each frame from memory (ViBe_FrameDecoder::DecodeMemory).
+ *
+ * A reader thread reads batch k+1 while the decoder works through batch k, each batch by a team of OpenMP threads so
+ * the latency of its files overlaps (which is what matters on network storage). The buffers are a ring of two
+ * batches, the reader waits for the decoder to be done with batch k-1 before reading batch k+1 over it. If the
+ * thread can't be started each batch is read when the decoder reaches it.
+ */
+class ViBe_FramePrefetcher
+{
+public:
+    ViBe_FramePrefetcher();
+    ~ViBe_FramePrefetcher();
+
+    /*
+     * Start reading the files, which must stay unchanged until the prefetcher is finished with
+     */
+    void Start(const vcl_vector<vcl_string>& filenames, int Depth = PREFETCH_DEPTH);
+
+    /*
+     * Block until the next frame has been read. data and size are valid until the next call, size is 0 if the file
+     * can't be read. Returns the index of the frame in filenames, or -1 once every frame has been handed out
+     */
+    int Next(const unsigned char*& data, unsigned long& size);
+
+private:
+    ViBe_FramePrefetcher(const ViBe_FramePrefetcher&);
+    ViBe_FramePrefetcher& operator=(const ViBe_FramePrefetcher&);
+
+    struct Slot
+    {
+        vcl_vector<unsigned char> buffer;
+        unsigned long size;
+    };
+
+    static void* ReaderMain(void* prefetcher);
+    void ReadAhead();
+    void ReadBatch(int batch);
+    void Stop();
+
+    const vcl_vector<vcl_string>* filenames;
+    int depth;
+    int next;                       // index of the next frame to hand out
+    vcl_vector<Slot> slots;         // two batches, frame f goes in slot f % (2*depth)
+    unsigned long largest;          // size of the largest file read so far, only touched by whoever reads the batches
+
+    pthread_t reader;
+    bool running;                   // whether the reader thread was started
+    pthread_mutex_t lock;           // guards the batch counts and stopping
+    pthread_cond_t changed;         // signalled when a batch count or stopping changes
+    int numBatches;
+    int readBatches;                // batches read so far
+    int allowedBatches;             // the reader may read batches below this, their slots are free
+    bool stopping;
+};
+
+#endif
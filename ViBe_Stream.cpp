@@ -0,0 +1,356 @@
+#include "ViBe_Stream.h"
+
+#ifndef _STRING_
+#define _STRING_
+#include <string.h>
+#endif
+
+#ifndef _STDLIB_
+#define _STDLIB_
+#include <stdlib.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+/// clamp an intermediate colour conversion value to a byte
+static unsigned char clampByte(int value)
+{
+    if (value < 0)
+    {
+        return 0;
+    }
+    if (value > 255)
+    {
+        return 255;
+    }
+    return (unsigned char)value;
+}
+
+ViBe_StreamReader::ViBe_StreamReader()
+{
+    stream = NULL;
+    ownsStream = false;
+    y4m = false;
+    width = 0;
+    height = 0;
+    chromaWidth = 0;
+    chromaHeight = 0;
+}
+
+ViBe_StreamReader::~ViBe_StreamReader()
+{
+    this->Close();
+}
+
+bool ViBe_StreamReader::Open(const vcl_string& path, int Width, int Height)
+{
+    this->Close();
+    if (path == "-")
+    {
+        stream = stdin;
+        ownsStream = false;
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    }
+    else
+    {
+        stream = fopen(path.c_str(), "rb");
+        ownsStream = true;
+    }
+    if (stream == NULL)
+    {
+        return false;
+    }
+
+    if ((Width > 0) && (Height > 0))
+    {
+        /// raw packed RGB, no header
+        y4m = false;
+        width = Width;
+        height = Height;
+        frameBuffer.resize(width*height*3);
+        return true;
+    }
+
+    y4m = true;
+    return this->ReadHeader();
+}
+
+bool ViBe_StreamReader::ReadLine(vcl_string& line)
+{
+    line.clear();
+    int c;
+    while ((c = fgetc(stream)) != EOF)
+    {
+        if (c == '\n')
+        {
+            return true;
+        }
+        line += (char)c;
+    }
+    return false;
+}
+
+bool ViBe_StreamReader::ReadHeader()
+{
+    vcl_string header;
+    if (!this->ReadLine(header) || (header.compare(0, 9, "YUV4MPEG2") != 0))
+    {
+        return false;
+    }
+
+    /// parameters are separated by single spaces, each starts with a one letter tag
+    vcl_string chroma = "420jpeg";
+    width = 0;
+    height = 0;
+    frameRate = "";
+    size_t start = 9;
+    while (start < header.size())
+    {
+        size_t end = header.find(' ', start + 1);
+        if (end == vcl_string::npos)
+        {
+            end = header.size();
+        }
+        vcl_string token = header.substr(start + 1, end - start - 1);
+        if (token.size() > 0)
+        {
+            switch (token[0])
+            {
+            case 'W': width = atoi(token.c_str() + 1); break;
+            case 'H': height = atoi(token.c_str() + 1); break;
+            case 'F': frameRate = token.substr(1); break;
+            case 'C': chroma = token.substr(1); break;
+            default: break;
+            }
+        }
+        start = end;
+    }
+
+    if ((width <= 0) || (height <= 0))
+    {
+        return false;
+    }
+
+    if (chroma.compare(0, 3, "420") == 0)
+    {
+        chromaWidth = (width + 1) / 2;
+        chromaHeight = (height + 1) / 2;
+    }
+    else if (chroma == "422")
+    {
+        chromaWidth = (width + 1) / 2;
+        chromaHeight = height;
+    }
+    else if (chroma == "444")
+    {
+        chromaWidth = width;
+        chromaHeight = height;
+    }
+    else if (chroma == "mono")
+    {
+        chromaWidth = 0;
+        chromaHeight = 0;
+    }
+    else
+    {
+        /// 10 bit and alpha formats are not supported
+        return false;
+    }
+
+    frameBuffer.resize(width*height + 2*chromaWidth*chromaHeight);
+    return true;
+}
+
+bool ViBe_StreamReader::ReadFrame(vil_image_view<unsigned char>& frame)
+{
+    if (stream == NULL)
+    {
+        return false;
+    }
+
+    if (y4m)
+    {
+        /// every frame starts with a "FRAME" line, which may carry parameters we don't need
+        vcl_string frameHeader;
+        if (!this->ReadLine(frameHeader) || (frameHeader.compare(0, 5, "FRAME") != 0))
+        {
+            return false;
+        }
+    }
+
+    /// fread blocks until the whole frame has arrived, or the writer has closed the pipe
+    if (fread(&frameBuffer[0], 1, frameBuffer.size(), stream) != frameBuffer.size())
+    {
+        return false;
+    }
+
+    frame.set_size(width, height, 3);
+    vcl_ptrdiff_t istep = frame.istep();
+    vcl_ptrdiff_t planestep = frame.planestep();
+
+    if (!y4m)
+    {
+        const unsigned char* src = &frameBuffer[0];
+        for (int j=0; j<height; j++)
+        {
+            unsigned char* dst = frame.top_left_ptr() + j*frame.jstep();
+            for (int i=0; i<width; i++)
+            {
+                dst[0] = src[0];
+                dst[planestep] = src[1];
+                dst[2*planestep] = src[2];
+                src += 3;
+                dst += istep;
+            }
+        }
+        return true;
+    }
+
+    /// ITU-R BT.601 studio range YCbCr to RGB, 8 bit fixed point
+    const unsigned char* yPlane = &frameBuffer[0];
+    const unsigned char* uPlane = yPlane + width*height;
+    const unsigned char* vPlane = uPlane + chromaWidth*chromaHeight;
+    int xShift = (chromaWidth == width) ? 0 : 1;
+    int yShift = (chromaHeight == height) ? 0 : 1;
+    for (int j=0; j<height; j++)
+    {
+        unsigned char* dst = frame.top_left_ptr() + j*frame.jstep();
+        const unsigned char* yRow = yPlane + j*width;
+        const unsigned char* uRow = uPlane + (j >> yShift)*chromaWidth;
+        const unsigned char* vRow = vPlane + (j >> yShift)*chromaWidth;
+        for (int i=0; i<width; i++)
+        {
+            int c = 298 * (yRow[i] - 16);
+            int d = 0;
+            int e = 0;
+            if (chromaWidth > 0)
+            {
+                d = uRow[i >> xShift] - 128;
+                e = vRow[i >> xShift] - 128;
+            }
+            dst[0] = clampByte((c + 409*e + 128) >> 8);
+            dst[planestep] = clampByte((c - 100*d - 208*e + 128) >> 8);
+            dst[2*planestep] = clampByte((c + 516*d + 128) >> 8);
+            dst += istep;
+        }
+    }
+    return true;
+}
+
+void ViBe_StreamReader::Close()
+{
+    if ((stream != NULL) && ownsStream)
+    {
+        fclose(stream);
+    }
+    stream = NULL;
+    ownsStream = false;
+}
+
+int ViBe_StreamReader::getWidth()
+{
+    return width;
+}
+
+int ViBe_StreamReader::getHeight()
+{
+    return height;
+}
+
+bool ViBe_StreamReader::isY4M()
+{
+    return y4m;
+}
+
+vcl_string ViBe_StreamReader::getFrameRate()
+{
+    return frameRate;
+}
+
+ViBe_StreamWriter::ViBe_StreamWriter()
+{
+    stream = NULL;
+    ownsStream = false;
+    y4m = false;
+}
+
+ViBe_StreamWriter::~ViBe_StreamWriter()
+{
+    this->Close();
+}
+
+bool ViBe_StreamWriter::Open(const vcl_string& path, ViBe_StreamReader& source)
+{
+    this->Close();
+    if (path == "-")
+    {
+        stream = stdout;
+        ownsStream = false;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else
+    {
+        stream = fopen(path.c_str(), "wb");
+        ownsStream = true;
+    }
+    if (stream == NULL)
+    {
+        return false;
+    }
+
+    y4m = source.isY4M();
+    lineBuffer.resize(source.getWidth());
+    if (y4m)
+    {
+        fprintf(stream, "YUV4MPEG2 W%d H%d", source.getWidth(), source.getHeight());
+        if (source.getFrameRate().size() > 0)
+        {
+            fprintf(stream, " F%s", source.getFrameRate().c_str());
+        }
+        fprintf(stream, " Ip A1:1 Cmono\n");
+        fflush(stream);
+    }
+    return true;
+}
+
+bool ViBe_StreamWriter::WriteFrame(vil_image_view<unsigned char>& mask)
+{
+    if (stream == NULL)
+    {
+        return false;
+    }
+    if (y4m)
+    {
+        fputs("FRAME\n", stream);
+    }
+    lineBuffer.resize(mask.ni());
+    for (unsigned j=0; j<mask.nj(); j++)
+    {
+        for (unsigned i=0; i<mask.ni(); i++)
+        {
+            lineBuffer[i] = mask(i,j,0);
+        }
+        if (fwrite(&lineBuffer[0], 1, lineBuffer.size(), stream) != lineBuffer.size())
+        {
+            return false;
+        }
+    }
+    return fflush(stream) == 0;
+}
+
+void ViBe_StreamWriter::Close()
+{
+    if ((stream != NULL) && ownsStream)
+    {
+        fclose(stream);
+    }
+    stream = NULL;
+    ownsStream = false;
+}
@@ -0,0 +1,99 @@
+#ifndef __VIBE_STREAM_H__
+#define __VIBE_STREAM_H__
+
+#include <vil/vil_image_view.h>
+
+#ifndef _VCL_STRING_
+#define _VCL_STRING_
+#include <vcl_string.h>
+#endif
+
+#ifndef _VCL_VECTOR_
+#define _VCL_VECTOR_
+#include <vcl_vector.h>
+#endif
+
+#ifndef _STDIO_
+#define _STDIO_
+#include <stdio.h>
+#endif
+
+/*
+ * Frame source that reads a raw video stream from stdin ("-") or a named pipe, so that an external decoder process
+ * can be placed in front of the segmenter without any intermediate files.
+ * Two framings are supported:
+ *  - YUV4MPEG2 (y4m), the dimensions and chroma subsampling (C420*, C422, C444, Cmono) are read from the stream header
+ *    and each frame is converted to RGB as it arrives
+ *  - raw packed RGB (3 bytes per pixel, no header), the dimensions must be given when the stream is opened
+ */
+class ViBe_StreamReader
+{
+public:
+    ViBe_StreamReader();
+    ~ViBe_StreamReader();
+
+    /*
+     * Open the stream
+     * path -   file or named pipe to read, "-" reads from stdin
+     * Width -  width of raw frames, 0 if the stream has a y4m header
+     * Height - height of raw frames, 0 if the stream has a y4m header
+     * returns false if the stream can't be opened or the header is not understood
+     */
+    bool Open(const vcl_string& path, int Width, int Height);
+
+    /*
+     * Block until the next frame has arrived and convert it to an RGB image of size Width x Height
+     * returns false at the end of the stream
+     */
+    bool ReadFrame(vil_image_view<unsigned char>& frame);
+
+    void Close();
+
+    int getWidth();
+    int getHeight();
+    bool isY4M();
+    vcl_string getFrameRate();      // F parameter of the y4m header, empty for raw streams
+
+protected:
+    bool ReadHeader();
+    bool ReadLine(vcl_string& line);
+
+private:
+    FILE* stream;
+    bool ownsStream;                // false when reading stdin
+    bool y4m;
+    int width;
+    int height;
+    int chromaWidth;                // size of the U and V planes of a y4m frame, 0 for Cmono
+    int chromaHeight;
+    vcl_string frameRate;
+    vcl_vector<unsigned char> frameBuffer;
+};
+
+/*
+ * Writes segmentation masks to stdout ("-") or a file using the same framing as the input stream. A y4m input gives
+ * a Cmono y4m output with the same frame rate, a raw input gives raw 8 bit masks of Width x Height bytes.
+ */
+class ViBe_StreamWriter
+{
+public:
+    ViBe_StreamWriter();
+    ~ViBe_StreamWriter();
+
+    bool Open(const vcl_string& path, ViBe_StreamReader& source);
+
+    /*
+     * Write a single plane mask and flush it, so the consumer sees it as soon as it has been segmented
+     */
+    bool WriteFrame(vil_image_view<unsigned char>& mask);
+
+    void Close();
+
+private:
+    FILE* stream;
+    bool ownsStream;
+    bool y4m;
+    vcl_vector<unsigned char> lineBuffer;
+};
+
+#endif
@@ -16,3 +16,36 @@ const int minSamples = 2; // amount of random subsampling
 #define MINSAMPLES 2
 #define SUBSAMPLING 16
 #define NUM_TRAINING_IMAGES 20
+#define DIRTY_TILE_SIZE 16
+
+// distance modes, how a pixel is matched against a sample
+#define DISTANCE_RGB 0              // euclidean distance in RGB must be less than RADIUS
+#define DISTANCE_CHROMA 1           // chromaticity and brightness ratio, tolerant of global lighting changes
+#define CHROMA_RADIUS 10            // max L1 distance between normalised r,g chromaticities (0-255 scale)
+#define CHROMA_MIN_INTENSITY 60     // chromaticity of samples darker than this (r+g+b) is noise, only brightness is tested
+#define BRIGHTNESS_LOW 154          // a matching pixel's r+g+b is at least 154/256 (0.6) of the sample's
+#define BRIGHTNESS_HIGH 384         // and at most 384/256 (1.5) of it
+#define BRIGHTNESS_MIN_RANGE 30     // but the window is never narrower than +-30 around the sample
+
+// optional features of each sample that a pixel keeps up to date, only for the modes that use them (ViBe_Pixel::SetFeatures)
+#define FEATURE_CHROMA 1            // brightness window and chromaticity, for DISTANCE_CHROMA
+#define FEATURE_ORDER 2             // sample slots sorted by intensity, for sorted matching
+#define FEATURE_ENVELOPE 4          // per channel min / max of the samples, for envelope rejection
+
+// global illumination change handling
+#define ILLUMINATION_OFF 0
+#define ILLUMINATION_FAST_UPDATE 1  // update every pixel at a high rate for a while
+#define ILLUMINATION_RESEED 2       // re-seed the model from the current frame
+#define ILLUMINATION_THRESHOLD 0.4  // foreground fraction of a frame that may indicate a lighting change
+#define ILLUMINATION_FRAMES 10      // frames to adapt for
+#define ILLUMINATION_SUBSAMPLING 2  // update rate while adapting
+#define ILLUMINATION_GRID 4         // the foreground must be spread over 3/4 of the cells of this grid
+
+// camera jitter compensation
+#define JITTER_REFRESH_FRAMES 100   // frames between rebuilding the background profiles frames are aligned to
+
+// pixel-major packed samples, the samples of a pixel stored as one lane per channel
+#define PACKED_LANE NUM_SAMPLES                     // bytes per channel lane, the lanes follow each other
+// bytes per pixel, the last lane padded to whole 8 sample loads and the block to whole cache lines (64 for 20 samples)
+#define PACKED_BLOCK (((2*PACKED_LANE + ((NUM_SAMPLES + 7) / 8)*8 + PACKED_ALIGN - 1) / PACKED_ALIGN)*PACKED_ALIGN)
+#define PACKED_ALIGN 64                             // blocks start on a cache line